@@ -15,11 +15,22 @@
     along with Vajolet.  If not, see <http://www.gnu.org/licenses/>
 */
 
+#include <algorithm>
+#include <chrono>
 #include <cstdint>
+#include <iomanip>
+#include <limits>
+#include <random>
 #include <string>
 #include <vector>
 
 #include "vajo_io.h"
+#include "compactMagics.h"
+#include "koggeStone.h"
+#include "magicmoves.h"
+#include "movepicker.h"
+#include "perft.h"
+#include "pextAttacks.h"
 #include "position.h"
 #include "search.h"
 #include "searchResult.h"
@@ -55,10 +66,16 @@ static std::string getNodesPerSecond(const uint64_t nodeCount, const int64_t tim
 	}
 }
 
-void benchmark() {
+struct benchmarkResult {
+	int64_t time;
+	uint64_t nodes;
+	ttStatistics::snapshot ttStats;
+};
+
+static benchmarkResult runBenchmark(const bool useLargePages, const unsigned int hashSize = 32) {
 	// initialize search parameters
 	uciParameters::useOwnBook = false;
-	transpositionTable::getInstance().setSize(32);
+	transpositionTable::getInstance().setSize(hashSize, useLargePages);
 	
 	SearchTimer st;
 	SearchLimits sl;
@@ -68,21 +85,337 @@ void benchmark() {
 	
 	// iterate positions
 	uint64_t nodeCount = 0;
+	ttStatistics::snapshot ttStats = {};
 	unsigned int i = 0;
 	for (auto pos: positions) {	
 		src.getPosition().setupFromFen(pos);
 		sync_cout << "Position: " << (++i) << '/' << positions.size() << sync_endl;
 		src.manageNewSearch();
 		nodeCount += src.getVisitedNodes();
+		
+		// the counters are reset at every new search
+		const auto s = ttStatistics::get();
+		for (unsigned int c = 0; c < ttStats.size(); ++c) {
+			ttStats[c] += s[c];
+		}
 	}
 	
 	// get total time
-	const auto totalTime = st.getElapsedTime();
+	return {st.getElapsedTime(), nodeCount, ttStats};
+}
+
+void benchmark(const unsigned int hashSize) {
+	const auto res = runBenchmark(uciParameters::largePages, hashSize);
 
 	// print result
 	sync_cout << "\n==========================="
-		<< "\nTotal time (ms) : " << totalTime
-		<< "\nNodes searched  : " << nodeCount
-		<< "\nNodes/second    : " << getNodesPerSecond(nodeCount, totalTime)
+		<< "\nTotal time (ms) : " << res.time
+		<< "\nNodes searched  : " << res.nodes
+		<< "\nNodes/second    : " << getNodesPerSecond(res.nodes, res.time)
+		<< "\nHash memory     : " << transpositionTable::getInstance().getMemoryTypeName()
+		<< "\nHash entries    : " << transpositionTable::getInstance().getEntries() << " (" << hashSize << "MB)"
+		<< sync_endl;
+	if (ttStatistics::enabled) {
+		sync_cout << "info string " << ttStatistics::format(res.ttStats) << sync_endl;
+	}
+}
+
+/*! \brief give the transposition table back the size and the pages set by the uci options, cleared
+*/
+static void restoreHashTable() {
+	auto& tt = transpositionTable::getInstance();
+	tt.setSize(std::max(1u, uciParameters::hashSize), uciParameters::largePages);
+	tt.clear();
+}
+
+/*! \brief run the benchmark with the transposition table on normal pages and on huge pages
+	the runs are done in the order normal, huge, huge, normal so that no mode gets all the warm caches
+*/
+void largePagesBenchmark() {
+	benchmarkResult normal = {0, 0, {}}, large = {0, 0, {}};
+	std::string largeName;
+	for (const bool useLargePages: {false, true, true, false}) {
+		const auto res = runBenchmark(useLargePages);
+		auto& sum = useLargePages ? large : normal;
+		sum.time += res.time;
+		sum.nodes += res.nodes;
+		if (useLargePages) {
+			largeName = transpositionTable::getInstance().getMemoryTypeName();
+		}
+	}
+	restoreHashTable();
+	
+	sync_cout << "\n==========================="
+		<< "\nnormal pages Nodes/second : " << getNodesPerSecond(normal.nodes, normal.time)
+		<< "\n" << largeName << " Nodes/second : " << getNodesPerSecond(large.nodes, large.time)
+		<< sync_endl;
+}
+
+/*! \brief measure the average latency of a transposition table probe on random keys, so that almost every probe is a cache miss
+*/
+void ttProbeBenchmark(const unsigned int mbSize) {
+	auto& tt = transpositionTable::getInstance();
+	tt.setSize(mbSize, uciParameters::largePages);
+	
+	const unsigned int probes = 10000000;
+	std::mt19937_64 gen(1);
+	
+	// fill part of the table so that probes don't only hit empty clusters
+	for (unsigned int i = 0; i < probes / 4; ++i) {
+		tt.store(HashKey(gen()), 0, typeExact, 0, Move::NOMOVE, 0);
+	}
+	
+	uint64_t hits = 0;
+	const auto start = std::chrono::steady_clock::now();
+	for (unsigned int i = 0; i < probes; ++i) {
+		hits += tt.probe(HashKey(gen())).getType() != typeVoid;
+	}
+	const auto end = std::chrono::steady_clock::now();
+	const auto ns = std::chrono::duration_cast<std::chrono::nanoseconds>(end - start).count();
+	// the dummy entries must not reach the next search
+	restoreHashTable();
+	
+	sync_cout << "\n==========================="
+		<< "\nHash size (MB)  : " << mbSize
+		<< "\nProbes          : " << probes
+		<< "\nHits            : " << hits
+		<< "\nns/probe        : " << double(ns) / probes
+		<< sync_endl;
+}
+
+/*! \brief measure the average time of an evaluation and of the material data lookup, on the children of the benchmark positions
+	the material data is read from the material table and calculated from scratch, as it was done before the table existed
+*/
+void evalBenchmark() {
+	const unsigned int repetitions = 1000;
+	Position p;
+	p.updateNnue();
+	Position::materialEntry e;
+	uint64_t evals = 0;
+	int64_t evalNs = 0, tableNs = 0, calcNs = 0;
+	Score checksum = 0;
+
+	for (auto pos: positions) {
+		p.setupFromFen(pos);
+		MovePicker mp(p);
+		Move m;
+		while ((m = mp.getNextMove())) {
+			p.doMove(m);
+			const auto t0 = std::chrono::steady_clock::now();
+			for (unsigned int i = 0; i < repetitions; ++i) {
+				checksum += p.eval<false>();
+			}
+			const auto t1 = std::chrono::steady_clock::now();
+			for (unsigned int i = 0; i < repetitions; ++i) {
+				checksum += p.getMaterialData().gamePhase;
+			}
+			const auto t2 = std::chrono::steady_clock::now();
+			for (unsigned int i = 0; i < repetitions; ++i) {
+				p.calcMaterialData(e);
+				checksum += e.gamePhase;
+			}
+			const auto t3 = std::chrono::steady_clock::now();
+			p.undoMove();
+
+			evals += repetitions;
+			evalNs += std::chrono::duration_cast<std::chrono::nanoseconds>(t1 - t0).count();
+			tableNs += std::chrono::duration_cast<std::chrono::nanoseconds>(t2 - t1).count();
+			calcNs += std::chrono::duration_cast<std::chrono::nanoseconds>(t3 - t2).count();
+		}
+	}
+
+	sync_cout << "\n==========================="
+		<< "\nEvaluator            : " << ( p.isNnueActive() ? "nnue" : "classical" )
+		<< "\nEvaluations          : " << evals
+		<< "\nns/eval              : " << double(evalNs) / evals
+		<< "\nns/material table    : " << double(tableNs) / evals
+		<< "\nns/material calc     : " << double(calcNs) / evals
+		<< "\nchecksum             : " << checksum
+		<< sync_endl;
+}
+
+template<bitMap (*attackFrom)(const tSquare, const bitMap)> static bitMap attacksOfSet(bitMap sliders, const bitMap occupancy) {
+	bitMap res = 0;
+	while (sliders) {
+		res |= attackFrom(iterateBit(sliders), occupancy);
+	}
+	return res;
+}
+
+// the plain magic lookups, whatever table movegen uses
+static bitMap magicRookAttacks(const tSquare sq, const bitMap occupancy) {
+	return *(magicmoves_r_indices[sq] + (((occupancy & magicmoves_r_mask[sq]) * magicmoves_r_magics[sq]) >> magicmoves_r_shift[sq]));
+}
+
+static bitMap magicBishopAttacks(const tSquare sq, const bitMap occupancy) {
+	return *(magicmoves_b_indices[sq] + (((occupancy & magicmoves_b_mask[sq]) * magicmoves_b_magics[sq]) >> magicmoves_b_shift[sq]));
+}
+
+/*! \brief compare the slider attack kernels on the slider sets of the children of the benchmark positions
+	the sets are the rooks, bishops and queens of a side, as the attack maps and the evaluation use them, and the single sliders.
+	The perft speed of the movegen table compiled in the build is reported too, to compare builds
+*/
+void slidersBenchmark() {
+	const unsigned int repetitions = 2000;
+	struct sample { bitMap sliders; bitMap occupancy; };
+	std::vector<sample> rookSets, bishopSets, rookSingles, bishopSingles;
+	Position p;
+
+	for (auto pos: positions) {
+		p.setupFromFen(pos);
+		MovePicker mp(p);
+		Move m;
+		while ((m = mp.getNextMove())) {
+			p.doMove(m);
+			const bitMap occupancy = p.getOccupationBitmap();
+			for (const bitboardIndex rooks: {whiteRooks, blackRooks}) {
+				const bitMap b = p.getBitmap(rooks) | p.getBitmap(bitboardIndex(rooks - 1));
+				if (b) { rookSets.push_back({b, occupancy}); }
+			}
+			for (const bitboardIndex bishops: {whiteBishops, blackBishops}) {
+				const bitMap b = p.getBitmap(bishops) | p.getBitmap(bitboardIndex(bishops - 2));
+				if (b) { bishopSets.push_back({b, occupancy}); }
+			}
+			for (bitMap b = p.getBitmap(whiteRooks) | p.getBitmap(blackRooks); b;) { rookSingles.push_back({bitSet(iterateBit(b)), occupancy}); }
+			for (bitMap b = p.getBitmap(whiteBishops) | p.getBitmap(blackBishops); b;) { bishopSingles.push_back({bitSet(iterateBit(b)), occupancy}); }
+			p.undoMove();
+		}
+	}
+
+	// the tables not used by movegen aren't filled at startup
+	initmagicmoves();
+	CompactMagics::init();
+	PextAttacks::init();
+
+	// a 64 MB table read at random before every lookup, as the transposition table does, to put the attack tables under cache pressure
+	std::vector<uint64_t> ttLike(uint64_t(1) << 23);
+	for (size_t i = 0; i < ttLike.size(); ++i) { ttLike[i] = i; }
+
+	bitMap reference = 0;
+	bool agree = true;
+	auto measure = [&](const std::vector<sample>& samples, auto attacks, const bool pressure) {
+		const unsigned int reps = pressure ? repetitions / 10 : repetitions;
+		uint64_t r = 0x9E3779B97F4A7C15ULL;
+		bitMap sum = 0;
+		const auto t0 = std::chrono::steady_clock::now();
+		for (unsigned int i = 0; i < reps; ++i) {
+			for (auto& s: samples) {
+				if (pressure) {
+					r = r * 6364136223846793005ULL + 1442695040888963407ULL;
+					sum += ttLike[r >> 41];
+				}
+				sum += attacks(s.sliders, s.occupancy ^ i);
+			}
+		}
+		const auto t1 = std::chrono::steady_clock::now();
+		// the first kernel measured on a sample set is the reference for the others
+		if (!reference) { reference = sum; }
+		agree &= sum == reference;
+		return double(std::chrono::duration_cast<std::chrono::nanoseconds>(t1 - t0).count()) / (double(samples.size()) * reps);
+	};
+	auto print = [&](const std::string& name, const std::vector<sample>& samples, auto magic, auto compact, auto pext, auto kogge, const bool pressure) {
+		reference = 0;
+		measure(samples, magic, pressure);	// warm up
+		sync_cout << std::left << std::setw(21) << name << ": magic " << measure(samples, magic, pressure) << " ns"
+			<< ", compact magic " << measure(samples, compact, pressure) << " ns";
+#if defined(__BMI2__)
+		std::cout << ", pext " << measure(samples, pext, pressure) << " ns";
+#else
+		(void)pext;
+#endif
+		std::cout << ", kogge-stone " << measure(samples, kogge, pressure) << " ns" << sync_endl;
+	};
+
+	sync_cout << "\n==========================="
+		<< "\nKernel               : " << KoggeStone::kernelName()
+		<< "\nSamples              : " << rookSets.size() + bishopSets.size() + rookSingles.size() + bishopSingles.size()
+		<< "\nTable size (KB)      : magic and pext " << PextAttacks::tableSize * sizeof(bitMap) / 1024
+		<< ", compact magic " << (CompactMagics::indexSize + CompactMagics::attacksSize * sizeof(bitMap)) / 1024
+		<< sync_endl;
+	// lambdas, so that the kernels are inlined in the measure loop
+	auto magicRooks = [](const bitMap s, const bitMap o) { return attacksOfSet<magicRookAttacks>(s, o); };
+	auto magicBishops = [](const bitMap s, const bitMap o) { return attacksOfSet<magicBishopAttacks>(s, o); };
+	auto compactRooks = [](const bitMap s, const bitMap o) { return attacksOfSet<CompactMagics::rookAttacks>(s, o); };
+	auto compactBishops = [](const bitMap s, const bitMap o) { return attacksOfSet<CompactMagics::bishopAttacks>(s, o); };
+	auto pextRooks = [](const bitMap s, const bitMap o) { return attacksOfSet<PextAttacks::rookAttacks>(s, o); };
+	auto pextBishops = [](const bitMap s, const bitMap o) { return attacksOfSet<PextAttacks::bishopAttacks>(s, o); };
+	auto koggeRooks = [](const bitMap s, const bitMap o) { return KoggeStone::rookAttacks(s, o); };
+	auto koggeBishops = [](const bitMap s, const bitMap o) { return KoggeStone::bishopAttacks(s, o); };
+	auto noAttacks = [](const bitMap, const bitMap) { return bitMap(0); };
+	for (const bool pressure: {false, true}) {
+		if (pressure) {
+			reference = 0;
+			sync_cout << "with a table probe   : probe alone " << measure(rookSingles, noAttacks, true) << " ns" << sync_endl;
+		}
+		print("rooks and queens", rookSets, magicRooks, compactRooks, pextRooks, koggeRooks, pressure);
+		print("bishops and queens", bishopSets, magicBishops, compactBishops, pextBishops, koggeBishops, pressure);
+		print("single rook", rookSingles, magicRooks, compactRooks, pextRooks, koggeRooks, pressure);
+		print("single bishop", bishopSingles, magicBishops, compactBishops, pextBishops, koggeBishops, pressure);
+	}
+	sync_cout << "Kernels agree        : " << (agree ? "yes" : "no") << sync_endl;
+
+	// movegen as a whole, without the perft hash
+	const bool useHash = Perft::perftUseHash;
+	Perft::perftUseHash = false;
+	unsigned long long nodes = 0;
+	const auto t0 = std::chrono::steady_clock::now();
+	const unsigned int depths[3] = {5, 4, 6};
+	for (unsigned int i = 0; i < 3; ++i) {
+		p.setupFromFen(positions[i]);
+		nodes += Perft(p).perft(depths[i]);
+	}
+	const auto t1 = std::chrono::steady_clock::now();
+	Perft::perftUseHash = useHash;
+	sync_cout << "Movegen table        : " << Movegen::sliderTableName()
+		<< "\nPerft nodes          : " << nodes
+		<< "\nPerft nodes/second   : " << getNodesPerSecond(nodes, std::chrono::duration_cast<std::chrono::milliseconds>(t1 - t0).count())
+		<< sync_endl;
+}
+
+/*! \brief measure the average time of a doMove/undoMove pair, on the moves of the children of the benchmark positions
+
+	every position is timed in a few batches and the fastest one is kept, to filter out the noise of the other processes.
+*/
+void doMoveBenchmark() {
+	const unsigned int batches = 5;
+	const unsigned int repetitions = 40;
+	Position p;
+	uint64_t moves = 0;
+	int64_t ns = 0;
+	tKey checksum = 0;
+
+	for (auto pos: positions) {
+		p.setupFromFen(pos);
+		MovePicker mp(p);
+		Move m;
+		while ((m = mp.getNextMove())) {
+			p.doMove(m);
+			MoveList<MAX_MOVE_PER_POSITION> moveList;
+			p.getMoveGen().generateMoves<Movegen::genType::allMg>(moveList);
+			int64_t best = std::numeric_limits<int64_t>::max();
+			for (unsigned int b = 0; b < batches; ++b) {
+				const auto t0 = std::chrono::steady_clock::now();
+				for (unsigned int i = 0; i < repetitions; ++i) {
+					for (auto child: moveList) {
+						p.doMove(child);
+						checksum += p.getKey().getKey();
+						p.undoMove();
+					}
+				}
+				const auto t1 = std::chrono::steady_clock::now();
+				best = std::min(best, int64_t(std::chrono::duration_cast<std::chrono::nanoseconds>(t1 - t0).count()));
+			}
+			ns += best;
+			moves += uint64_t(moveList.size()) * repetitions;
+			p.undoMove();
+		}
+	}
+
+	sync_cout << "\n==========================="
+		<< "\nsizeof(state)        : " << sizeof(state)
+		<< "\nsizeof(Position)     : " << sizeof(Position)
+		<< "\nMoves                : " << moves
+		<< "\nns/doMove+undoMove   : " << double(ns) / moves
+		<< "\nchecksum             : " << checksum
 		<< sync_endl;
 }
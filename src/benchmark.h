@@ -18,7 +18,12 @@
 #define BENCHMARK_H_
 
 
-void benchmark();
+void benchmark(const unsigned int hashSize = 32);
+void largePagesBenchmark();
+void ttProbeBenchmark(const unsigned int mbSize);
+void evalBenchmark();
+void slidersBenchmark();
+void doMoveBenchmark();
 
 
 #endif /* BENCHMARK_H_ */
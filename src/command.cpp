@@ -26,6 +26,7 @@
 #include "vajo_io.h"
 #include "movepicker.h"
 #include "parameters.h"
+#include "nnue.h"
 #include "perft.h"
 #include "position.h"
 #include "pvLine.h"
@@ -53,6 +54,7 @@ public:
 	void printScore(const signed int cp) const override;
 	void printBestMove( const Move& m, const Move& ponder, bool isChess960) const override;
 	void printGeneralInfo( const unsigned int fullness, const unsigned long long int thbits, const unsigned long long int nodes, const long long int time) const override;
+	void printInfoString( const std::string& s ) const override;
 };
 
 
@@ -68,6 +70,7 @@ public:
 	void printScore(const signed int cp) const override;
 	void printBestMove( const Move& m, const Move& ponder, bool isChess960) const override;
 	void printGeneralInfo( const unsigned int fullness, const unsigned long long int thbits, const unsigned long long int nodes, const long long int time) const override;
+	void printInfoString( const std::string& s ) const override;
 };
 
 class UciManager::impl
@@ -91,17 +94,58 @@ private:
 	
 	static void setTTSize(unsigned int size)
 	{
-		unsigned long elements = transpositionTable::getInstance().setSize(size);
+		auto& tt = transpositionTable::getInstance();
+		unsigned long elements = tt.setSize(size, uciParameters::largePages);
 		sync_cout<<"info string hash table allocated, "<<elements<<" elements ("<<size<<"MB)"<<sync_endl;
+		sync_cout<<"info string hash table backed by "<<tt.getMemoryTypeName()<<sync_endl;
 	}
-	static void clearHash() {transpositionTable::getInstance().clear();}
+	static void setLargePages(bool)
+	{
+		// at startup the table is allocated by the Hash option
+		if( uciParameters::hashSize )
+		{
+			setTTSize( uciParameters::hashSize );
+		}
+	}
+	static void setSharedHash(std::string s)
+	{
+		auto& tt = transpositionTable::getInstance();
+		const std::string name = s == "<empty>" ? "" : s;
+		// the table is attached again only when the segment changes
+		if( name == tt.getSharedName() )
+		{
+			return;
+		}
+		unsigned long elements = tt.setSharedName( name );
+		sync_cout<<"info string hash table allocated, "<<elements<<" elements, backed by "<<tt.getMemoryTypeName()<<sync_endl;
+	}
+	static void clearHash() {transpositionTable::getInstance().clear(); evalCache::getInstance().clear();}
+	static void setEvalCacheSize(unsigned int size) {evalCache::getInstance().setSize(size);}
+	static void setUseNnue(bool) {evalCache::getInstance().clear();}
+	static void setEvalFile( std::string s ) {
+		auto& net = nnue::getInstance();
+		evalCache::getInstance().clear();
+		if( s == "<empty>" )
+		{
+			net.unload();
+		}
+		else if( net.load(s) )
+		{
+			sync_cout<<"info string network "<<s<<" loaded"<<sync_endl;
+		}
+		else
+		{
+			sync_cout<<"info string error loading network "<<s<<sync_endl;
+		}
+	}
+	static void setPerftTTSize(unsigned int size) {PerftTranspositionTable::getInstance().setSize(size);}
 	static void setTTPath( std::string s ) {
 		auto&  szg = Syzygy::getInstance();
 		szg.setPath(s);
 		sync_cout<<"info string "<<szg.getSize()<<" tables found"<<sync_endl;
 	}
 	std::string unusedVersion;
-	unsigned int unusedSize;
+	unsigned int unusedEvalCacheSize;
 	static const char _PIECE_NAMES_FEN[];
 	static const std::string _StartFEN;
 	
@@ -214,7 +258,7 @@ private:
 	class CheckUciOption final: public UciOption
 	{
 	public:
-		CheckUciOption( const std::string& name, bool& value, const bool defVal):UciOption(name),_defaultValue(defVal), _value(value)
+		CheckUciOption( const std::string& name, bool& value, const bool defVal, void (*callbackFunc)(bool) = nullptr):UciOption(name),_defaultValue(defVal), _value(value), _callbackFunc(callbackFunc)
 		{
 			setValue( _defaultValue ? "true" : "false", false );
 		}
@@ -249,11 +293,16 @@ private:
 				sync_cout<<"info string error setting "<<_name<<sync_endl;
 				return false;
 			}
+			if(_callbackFunc)
+			{
+				_callbackFunc(_value);
+			}
 			return true;
 		}
 	private:
 		const bool _defaultValue;
 		bool& _value;
+		void (*_callbackFunc)(bool);
 	};
 
 	class ButtonUciOption final: public UciOption
@@ -293,7 +342,17 @@ UciManager::impl::impl(): _pos(Position::pawnHash::off)
 	std::cout.rdbuf()->pubsetbuf( nullptr, 0 );
 	std::cin.rdbuf()->pubsetbuf( nullptr, 0 );
 	
-	_optionList.emplace_back( new SpinUciOption("Hash",unusedSize, setTTSize, 1, 1, 65535));
+	// LargePages is created before Hash, the table is allocated once at startup
+	_optionList.emplace_back( new CheckUciOption("LargePages", uciParameters::largePages, true, setLargePages));
+	_optionList.emplace_back( new SpinUciOption("Hash", uciParameters::hashSize, setTTSize, 1, 1, 1048576));
+	_optionList.emplace_back( new StringUciOption("SharedHash", uciParameters::sharedHash, setSharedHash, "<empty>"));
+	_optionList.emplace_back( new CheckUciOption("QSearchHash", uciParameters::qsearchHash, false));
+	// the pawn tables are resized at the beginning of the next search
+	_optionList.emplace_back( new SpinUciOption("PawnHash", uciParameters::pawnHashSize, nullptr, 1, 1, 4096));
+	_optionList.emplace_back( new CheckUciOption("SharedPawnHash", uciParameters::sharedPawnHash, false));
+	_optionList.emplace_back( new StringUciOption("EvalFile", uciParameters::evalFile, setEvalFile, "<empty>"));
+	_optionList.emplace_back( new CheckUciOption("UseNNUE", uciParameters::useNnue, false, setUseNnue));
+	_optionList.emplace_back( new SpinUciOption("EvalCache", unusedEvalCacheSize, setEvalCacheSize, evalCache::defaultSize, 0, 1024));
 	_optionList.emplace_back( new SpinUciOption("Threads", uciParameters::threads, nullptr, 1, 1, 128));
 	_optionList.emplace_back( new SpinUciOption("MultiPV", uciParameters::multiPVLines, nullptr, 1, 1, 500));
 	_optionList.emplace_back( new CheckUciOption("Ponder", uciParameters::Ponder, true));
@@ -306,6 +365,7 @@ UciManager::impl::impl(): _pos(Position::pawnHash::off)
 	_optionList.emplace_back( new CheckUciOption("Syzygy50MoveRule", uciParameters::Syzygy50MoveRule, true));
 	_optionList.emplace_back( new ButtonUciOption("ClearHash", clearHash));
 	_optionList.emplace_back( new CheckUciOption("PerftUseHash", Perft::perftUseHash, false));
+	_optionList.emplace_back( new SpinUciOption("PerftHash", Perft::perftHashSize, setPerftTTSize, 16, 1, 65535));
 	_optionList.emplace_back( new CheckUciOption("reduceVerbosity", UciStandardOutput::reduceVerbosity, false));
 	_optionList.emplace_back( new CheckUciOption("UCI_Chess960", uciParameters::Chess960, false));
 	
@@ -727,6 +787,21 @@ bool UciManager::impl::uciParser(std::string& cmd) {
 		sync_cout << "gamePhase:"  << _pos.getGamePhase( _pos.getActualState() )/65536.0*100 << "%" << sync_endl;
 
 	}
+	else if (token == "savehash" || token == "loadhash")
+	{
+		std::string fileName;
+		is >> std::ws;
+		std::getline( is, fileName );
+		auto& tt = transpositionTable::getInstance();
+		if( token == "savehash" ? tt.saveToFile( fileName ) : tt.loadFromFile( fileName ) )
+		{
+			sync_cout << "info string hash table " << ( token == "savehash" ? "saved to " : "loaded from " ) << fileName << sync_endl;
+		}
+		else
+		{
+			sync_cout << "info string error " << ( token == "savehash" ? "saving" : "loading" ) << " hash table file " << fileName << sync_endl;
+		}
+	}
 	else if (token == "isready")
 	{
 		sync_cout << "readyok" << sync_endl;
@@ -766,7 +841,40 @@ bool UciManager::impl::uciParser(std::string& cmd) {
 	}
 	else if (token == "bench")
 	{
-		benchmark();
+		std::string mode;
+		if( is >> mode && mode == "largepages" )
+		{
+			largePagesBenchmark();
+		}
+		else if( mode == "ttprobe" )
+		{
+			unsigned int size = 256;
+			is >> size;
+			ttProbeBenchmark( size );
+		}
+		else if( mode == "eval" )
+		{
+			evalBenchmark();
+		}
+		else if( mode == "sliders" )
+		{
+			slidersBenchmark();
+		}
+		else if( mode == "domove" )
+		{
+			doMoveBenchmark();
+		}
+		else if( mode == "hash" )
+		{
+			// run the benchmark with a given hash size, to compare builds at equal memory
+			unsigned int size = 32;
+			is >> size;
+			benchmark( size );
+		}
+		else
+		{
+			benchmark();
+		}
 	}
 	else if (token == "ponderhit")
 	{
@@ -920,6 +1028,11 @@ void UciStandardOutput::printGeneralInfo( const unsigned int fullness, const uns
 	}
 }
 
+void UciStandardOutput::printInfoString( const std::string& s ) const
+{
+	sync_cout<<"info string "<<s<<sync_endl;
+}
+
 /*****************************
 uci Mute output implementation
 ******************************/
@@ -931,6 +1044,7 @@ void UciMuteOutput::printDepth() const{}
 void UciMuteOutput::printScore(const signed int ) const{}
 void UciMuteOutput::printBestMove( const Move&, const Move&, bool ) const{}
 void UciMuteOutput::printGeneralInfo( const unsigned int , const unsigned long long int , const unsigned long long int , const long long int ) const{}
+void UciMuteOutput::printInfoString( const std::string& ) const{}
 
 
 
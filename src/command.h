@@ -102,6 +102,7 @@ public:
 	virtual void printScore(const signed int cp) const = 0;
 	virtual void printBestMove( const Move& bm, const Move& ponder, bool isChess960 ) const = 0;
 	virtual void printGeneralInfo( const unsigned int fullness, const unsigned long long int thbits, const unsigned long long int nodes, const long long int time) const = 0;
+	virtual void printInfoString( const std::string& s ) const = 0;
 	
 protected:
 	unsigned int _depth;
@@ -0,0 +1,71 @@
+/*
+	This file is part of Vajolet.
+
+    Vajolet is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    Vajolet is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with Vajolet.  If not, see <http://www.gnu.org/licenses/>
+*/
+
+#include <algorithm>
+
+#include "compactMagics.h"
+#include "data.h"
+#include "koggeStone.h"
+#include "magicmoves.h"
+
+CompactMagics::entry CompactMagics::_rook[squareNumber];
+CompactMagics::entry CompactMagics::_bishop[squareNumber];
+alignas(64) uint8_t CompactMagics::_index[indexSize];
+alignas(64) bitMap CompactMagics::_attacks[attacksSize];
+
+void CompactMagics::init()
+{
+	uint8_t * nextIndex = _index;
+	bitMap * nextAttacks = _attacks;
+	auto fill = [&]( entry& e, const tSquare sq, const bitMap mask, const bitMap magic, const unsigned int shift, bitMap (*attacks)( const bitMap, const bitMap ) )
+	{
+		e.mask = mask;
+		e.magic = magic;
+		e.shift = shift;
+		e.index = nextIndex;
+		e.attacks = nextAttacks;
+		unsigned int count = 0;
+		// walk all the subsets of the mask
+		bitMap occupancy = 0;
+		do
+		{
+			const bitMap a = attacks( bitSet( sq ), occupancy );
+			const unsigned int n = unsigned( std::find( nextAttacks, nextAttacks + count, a ) - nextAttacks );
+			if( n == count )
+			{
+				nextAttacks[ count++ ] = a;
+			}
+			assert( count <= 256 );
+			nextIndex[ ( occupancy * magic ) >> shift ] = uint8_t( n );
+			occupancy = ( occupancy - mask ) & mask;
+		}
+		while( occupancy );
+		nextIndex += bitMap( 1 ) << ( 64 - shift );
+		nextAttacks += count;
+	};
+
+	for( tSquare sq = A1; sq < squareNumber; ++sq )
+	{
+		fill( _rook[sq], sq, magicmoves_r_mask[sq], magicmoves_r_magics[sq], magicmoves_r_shift[sq], KoggeStone::rookAttacks );
+	}
+	for( tSquare sq = A1; sq < squareNumber; ++sq )
+	{
+		fill( _bishop[sq], sq, magicmoves_b_mask[sq], magicmoves_b_magics[sq], magicmoves_b_shift[sq], KoggeStone::bishopAttacks );
+	}
+	assert( nextIndex == _index + indexSize );
+	assert( nextAttacks == _attacks + attacksSize );
+}
@@ -0,0 +1,73 @@
+/*
+	This file is part of Vajolet.
+
+    Vajolet is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    Vajolet is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with Vajolet.  If not, see <http://www.gnu.org/licenses/>
+*/
+
+#ifndef COMPACTMAGICS_H_
+#define COMPACTMAGICS_H_
+
+#include <cassert>
+#include <cstdint>
+
+#include "bitops.h"
+#include "tSquare.h"
+
+/*! \brief slider attacks with the magic indexing and a two level table
+
+	the magic index of a square selects a byte in the index table, which selects one of the distinct attack sets of the square
+	(at most 144 for a rook, 108 for a bishop). The index table takes 99 KB and the 6328 distinct attack sets 49 KB,
+	instead of the 841 KB of the plain magic table, at the cost of a second dependent load.
+	Movegen uses it when COMPACT_MAGIC_ATTACKS is defined, the other builds can still fill and query it.
+*/
+class CompactMagics
+{
+public:
+	/*! \brief fill the tables, it can be called more than once */
+	static void init();
+
+	inline static bitMap rookAttacks(const tSquare from, const bitMap occupancy)
+	{
+		assert(from < squareNumber);
+		const entry& e = _rook[from];
+		return e.attacks[ e.index[ ( ( occupancy & e.mask ) * e.magic ) >> e.shift ] ];
+	}
+
+	inline static bitMap bishopAttacks(const tSquare from, const bitMap occupancy)
+	{
+		assert(from < squareNumber);
+		const entry& e = _bishop[from];
+		return e.attacks[ e.index[ ( ( occupancy & e.mask ) * e.magic ) >> e.shift ] ];
+	}
+
+	static constexpr unsigned int indexSize = 96256 + 5248;	/*!< rook + bishop magic indexes*/
+	static constexpr unsigned int attacksSize = 4900 + 1428;	/*!< distinct rook + bishop attack sets*/
+
+private:
+	struct entry
+	{
+		bitMap mask;
+		bitMap magic;
+		const uint8_t * index;
+		const bitMap * attacks;
+		unsigned int shift;
+	};
+
+	static entry _rook[squareNumber];
+	static entry _bishop[squareNumber];
+	static uint8_t _index[indexSize];
+	static bitMap _attacks[attacksSize];
+};
+
+#endif /* COMPACTMAGICS_H_ */
@@ -61,7 +61,7 @@ bool Position::evalKxvsK(Score& res) const
 
 	res = SCORE_KNOWN_WIN + 50000;
 	res -= 10 * distance(winKingSquare,losKingSquare);// devo tenere il re vicino
-	res += 20 * distance(losKingSquare,E4);// devo portare il re avversario vicino al bordo
+	res += 20 * distance(losKingSquare, StrongColor == white ? E4 : E5);// devo portare il re avversario vicino al bordo
 	res += 50 * bitCnt(getBitmap(pieces));
 	assert( res < SCORE_MATE_IN_MAX_PLY);
 
@@ -289,7 +289,7 @@ bool Position::evalKQvsK(Score& res) const
 
 	res = SCORE_KNOWN_WIN + 40000;
 	res -= 10 * distance(enemySquare,kingSquare);// devo tenere il re vicino
-	res += 20 * distance(enemySquare,E4);// devo portare il re avversario vicino al bordo
+	res += 20 * distance(enemySquare, color == white ? E4 : E5);// devo portare il re avversario vicino al bordo
 
 	res *= sign;
 	return true;
@@ -324,7 +324,7 @@ bool Position::evalKRvsK(Score& res) const
 
 	res = SCORE_KNOWN_WIN + 30000;
 	res -= 10 * distance(enemySquare,kingSquare);// devo tenere il re vicino
-	res += 20 * distance(enemySquare,E4);// devo portare il re avversario vicino al bordo
+	res += 20 * distance(enemySquare, color == white ? E4 : E5);// devo portare il re avversario vicino al bordo
 
 	res *= mul;
 	return true;
@@ -35,26 +35,76 @@ static const int KingExposed[] = {
   };
 
 
+// change expected from the terms still missing at each lazy evaluation checkpoint, well above the 99.9th percentile measured on the bench positions
+static const Score lazyMarginPieces = 90000;
+static const Score lazyMarginThreats = 80000;
+
 simdScore traceRes={0,0,0,0};
 
 
 
 //---------------------------------------------
-const Position::materialStruct * Position::getMaterialData() const
+const Position::materialEntry& Position::getMaterialData() const
 {
-	tKey key = getMaterialKey().getKey();
+	const tKey key = getMaterialKey().getKey();
 
-	auto got= _materialKeyMap.find(key);
+	if( !_materialTable )
+	{
+		calcMaterialData( _materialScratch );
+		return _materialScratch;
+	}
+
+	materialEntry& e = (*_materialTable)[ key & ( _materialTableSize - 1 ) ];
+	if( e.key != key )
+	{
+		calcMaterialData( e );
+	}
+	return e;
+}
+
+void Position::calcMaterialData( materialEntry& e ) const
+{
+	e.key = getMaterialKey().getKey();
 
-	if( got == _materialKeyMap.end())
+	auto got = _materialKeyMap.find( e.key );
+	e.hasEndgame = got != _materialKeyMap.end();
+	if( e.hasEndgame )
 	{
-		return nullptr;
+		e.type = got->second.type;
+		e.pointer = got->second.pointer;
+		e.val = got->second.val;
 	}
 	else
 	{
-		 return &(got->second);
+		e.type = materialStruct::type::exact;
+		e.pointer = nullptr;
+		e.val = 0;
 	}
 
+	// analize k and pieces vs king
+	e.loneKing = ( bitCnt( getBitmap(whitePieces) ) == 1 && bitCnt( getBitmap(blackPieces) ) > 1 ) || ( bitCnt( getBitmap(whitePieces) ) > 1 && bitCnt( getBitmap(blackPieces) ) == 1 );
+
+	e.gamePhase = getGamePhase( getActualState() );
+
+	//	queen vs rook and 2 minors imbalance
+	e.imbalance = simdScore{0,0,0,0};
+	if( getPieceCount(blackPawns) + getPieceCount(whitePawns) == 0 )
+	{
+		if((int)getPieceCount(whiteQueens) - (int)getPieceCount(blackQueens) == 1
+				&& (int)getPieceCount(blackRooks) - (int)getPieceCount(whiteRooks) == 1
+				&& (int)getPieceCount(blackBishops) + (int)getPieceCount(blackKnights) - (int)getPieceCount(whiteBishops) - (int)getPieceCount(whiteKnights) == 2)
+		{
+			e.imbalance += queenVsRook2MinorsImbalance;
+
+		}
+		else if((int)getPieceCount(whiteQueens) - (int)getPieceCount(blackQueens) == -1
+				&& (int)getPieceCount(blackRooks) - (int)getPieceCount(whiteRooks) == -1
+				&& (int)getPieceCount(blackBishops) + (int)getPieceCount(blackKnights) - (int)getPieceCount(whiteBishops) -(int)getPieceCount(whiteKnights) == -2)
+		{
+			e.imbalance -= queenVsRook2MinorsImbalance;
+
+		}
+	}
 }
 
 
@@ -410,8 +460,29 @@ simdScore Position::evalPieces(const bitMap * const weakSquares,  bitMap * const
 	return res;
 }
 
+/*! \brief king shelter and pawn storm score, read from the pawn table when possible since it depends only on the pawns and the king square
+*/
 template<Color kingColor>
 Score Position::evalShieldStorm(tSquare ksq) const
+{
+	if( !_pawnHashTable )
+	{
+		return calcShieldStorm<kingColor>(ksq);
+	}
+	HashKey key = getPawnKey();
+	key.updatePiece( ksq, kingColor ? blackKing : whiteKing );
+
+	Score ks;
+	if( !_pawnHashTable->getShieldStorm( key, ks ) )
+	{
+		ks = calcShieldStorm<kingColor>(ksq);
+		_pawnHashTable->insertShieldStorm( key, ks );
+	}
+	return ks;
+}
+
+template<Color kingColor>
+Score Position::calcShieldStorm(tSquare ksq) const
 {
 	if( getFileOf(ksq) == FILEA )
 	{
@@ -463,7 +534,7 @@ simdScore Position::evalPassedPawn(bitMap pp, bitMap* attackedSquares) const
 	bitboardIndex ourRooks = c ? blackRooks : whiteRooks;
 	bitboardIndex enemyRooks = c ? whiteRooks : blackRooks;
 	bitboardIndex ourPawns = c ? blackPawns : whitePawns;
-	const state st = getActualState();
+	const state& st = getActualState();
 
 	simdScore score = {0,0,0,0};
 	while(pp)
@@ -622,6 +693,51 @@ template<Color c> simdScore Position::evalKingSafety(Score kingSafety, unsigned
 }
 
 
+/*! \brief move all the bits one rank toward the promotion rank of color c
+*/
+template<Color c>
+static inline bitMap shiftForward(const bitMap b)
+{
+	return c ? b >> 8 : b << 8;
+}
+
+/*! \brief extend all the bits up to the promotion rank of color c
+*/
+template<Color c>
+static inline bitMap fillForward(bitMap b)
+{
+	if( c )
+	{
+		b |= b >> 8;
+		b |= b >> 16;
+		b |= b >> 32;
+	}
+	else
+	{
+		b |= b << 8;
+		b |= b << 16;
+		b |= b << 32;
+	}
+	return b;
+}
+
+/*! \brief calc the squares attacked by the pawns of color c, the squares they can never attack and the holes in front of them
+*/
+template<Color c>
+void Position::calcPawnSpans(bitMap * const attackedSquares, bitMap * const weakSquares, bitMap * const holes) const
+{
+	constexpr bitboardIndex ourPawns = c ? blackPawns : whitePawns;
+	const bitMap pawns = getBitmap(ourPawns);
+
+	const bitMap pawnAttack = c ?
+		( ( pawns & ~fileMask(H1) ) >> 7 ) | ( ( pawns & ~fileMask(A1) ) >> 9 )
+		: ( ( pawns & ~fileMask(H1) ) << 9 ) | ( ( pawns & ~fileMask(A1) ) << 7 );
+
+	attackedSquares[ourPawns] = pawnAttack;
+	weakSquares[c] = ~fillForward<c>( pawnAttack );
+	holes[c] = weakSquares[c] & fillForward<c>( shiftForward<c>( pawns ) );
+}
+
 simdScore Position::calcPawnValues(bitMap& weakPawns, bitMap& passedPawns, bitMap * const attackedSquares , bitMap * const weakSquares, bitMap * const holes) const {
 	simdScore pawnResult = simdScore{0,0,0,0};
 	bitMap pawns = getBitmap(whitePawns);
@@ -642,47 +758,144 @@ simdScore Position::calcPawnValues(bitMap& weakPawns, bitMap& passedPawns, bitMa
 
 
 
-	bitMap temp = getBitmap(whitePawns);
-	bitMap pawnAttack = (temp & ~fileMask(H1) ) << 9;
-	pawnAttack |= (temp & ~fileMask(A1) ) << 7;
+	calcPawnSpans<white>(attackedSquares, weakSquares, holes);
+	calcPawnSpans<black>(attackedSquares, weakSquares, holes);
 
-	attackedSquares[whitePawns] = pawnAttack;
-	pawnAttack |= pawnAttack << 8;
-	pawnAttack |= pawnAttack << 16;
-	pawnAttack |= pawnAttack << 32;
+	pawnResult -= ( (int)bitCnt( holes[white] ) - (int)bitCnt( holes[black] ) ) * holesPenalty;
+	return pawnResult;
+}
 
-	weakSquares[white] = ~pawnAttack;
+/*! \brief squares around the king of color c used to count its attackers, empty when the opponent hasn't enough material for an attack
+*/
+template<Color c>
+bitMap Position::calcKingRing() const
+{
+	constexpr bitboardIndex ourKing = c ? blackKing : whiteKing;
+	if( getActualState().getNonPawnValue()[ c ? 0 : 2 ] < Position::pieceValue[Knights][0] + Position::pieceValue[Rooks][0] )
+	{
+		return 0;
+	}
 
+	tSquare k = getSquareOfThePiece(ourKing);
+	if( getRankOf(k) == ( c ? RANK8 : RANK1 ) )
+	{
+		k += c ? sud : north;
+	}
+	if( getFileOf(k) == FILEA )
+	{
+		k += est;
+	}
+	if( getFileOf(k) == FILEH )
+	{
+		k += ovest;
+	}
+	return Movegen::attackFrom<ourKing>(k) | bitSet( k );
+}
 
-	temp = getBitmap(blackPawns);
-	pawnAttack = ( temp & ~fileMask(H1) ) >> 7;
-	pawnAttack |= ( temp & ~fileMask(A1) ) >> 9;
+template<Color c>
+bool Position::hasBishopPair() const
+{
+	constexpr bitboardIndex ourBishops = c ? blackBishops : whiteBishops;
+	return getPieceCount(ourBishops) >= 2
+		&& ( getBitmap(ourBishops) & getColorBitmap(white) )
+		&& ( getBitmap(ourBishops) & getColorBitmap(black) );
+}
 
-	attackedSquares[blackPawns] = pawnAttack;
+static inline simdScore evalCenterControl(const bitMap pawnAttacks)
+{
+	return (int)bitCnt( pawnAttacks & centerBitmap ) * pawnCenterControl
+		+ (int)bitCnt( pawnAttacks & bigCenterBitmap ) * pawnBigCenterControl;
+}
 
-	pawnAttack |= pawnAttack >> 8;
-	pawnAttack |= pawnAttack >> 16;
-	pawnAttack |= pawnAttack >> 32;
+/*! \brief count the safe squares behind the central pawns of color c
+*/
+template<Color c>
+int Position::calcSpace(const bitMap * const attackedSquares) const
+{
+	constexpr bitboardIndex ourPawns = c ? blackPawns : whitePawns;
+	constexpr bitboardIndex theirPieces = c ? whitePieces : blackPieces;
+	const bitMap space = fillForward<c ? white : black>( getBitmap(ourPawns) & spaceMask ) & ~attackedSquares[theirPieces];
+	return (int)bitCnt( space );
+}
 
-	weakSquares[black] = ~pawnAttack;
+/*! \brief penalties for the pieces of color c attacked by pawns, weakly defended or undefended
+*/
+template<Color c>
+simdScore Position::evalThreats(const bitMap * const attackedSquares) const
+{
+	constexpr bitboardIndex ourPieces = c ? blackPieces : whitePieces;
+	constexpr bitboardIndex ourPawns = c ? blackPawns : whitePawns;
+	constexpr bitboardIndex theirKing = c ? whiteKing : blackKing;
+	constexpr bitboardIndex theirPawns = c ? whitePawns : blackPawns;
+	constexpr bitboardIndex theirPieces = c ? whitePieces : blackPieces;
 
-	temp = getBitmap(whitePawns) << 8;
-	temp |= temp << 8;
-	temp |= temp << 16;
-	temp |= temp << 32;
+	simdScore score = {0,0,0,0};
 
-	holes[white] = weakSquares[white] & temp;
+	bitMap pawnAttackedPieces = getBitmap( ourPieces ) & attackedSquares[ theirPawns ];
+	while(pawnAttackedPieces)
+	{
+		tSquare attacked = iterateBit( pawnAttackedPieces );
+		score -= attackedByPawnPenalty[ getPieceTypeAt(attacked) ];
+	}
 
+	// todo fare un weak piece migliore:qualsiasi pezzo attaccato riceve un malus dipendente dal suo pi debole attaccante e dal suo valore.
+	// volendo anche da quale pezzo  difeso
+	const bitMap undefendedMinors = ( getBitmap( c ? blackKnights : whiteKnights ) | getBitmap( c ? blackBishops : whiteBishops ) ) & ~attackedSquares[ourPieces];
+	if (undefendedMinors)
+	{
+		score -= undefendedMinorPenalty;
+	}
+	bitMap weakPieces = getBitmap(ourPieces) & attackedSquares[theirPieces] & ~attackedSquares[ourPawns];
+	while(weakPieces)
+	{
+		tSquare sq = iterateBit(weakPieces);
 
+		bitboardIndex attackedPieceType = getPieceTypeAt(sq);
+		for( bitboardIndex attackingPiece = theirPawns; attackingPiece >= theirKing; attackingPiece = (bitboardIndex)(attackingPiece - 1) )
+		{
+			if( isSquareSet( attackedSquares[ attackingPiece ], sq ) )
+			{
+				score -= weakPiecePenalty[ attackedPieceType ][ getPieceType( attackingPiece ) ];
+				break;
+			}
+		}
+	}
 
-	temp = getBitmap(blackPawns) >> 8;
-	temp |= temp >> 8;
-	temp |= temp >> 16;
-	temp |= temp >> 32;
+	if( getBitmap(ourPawns) & ~attackedSquares[ourPieces] & attackedSquares[theirKing] )
+	{
+		score -= weakPawnAttackedByKing;
+	}
+	return score;
+}
 
-	holes[black] = weakSquares[black] & temp;
-	pawnResult -= ( (int)bitCnt( holes[white] ) - (int)bitCnt( holes[black] ) ) * holesPenalty;
-	return pawnResult;
+/*! \brief pawn shelter of the king of color c, on its square or on the castle destinations still reachable
+*/
+template<Color c>
+Score Position::evalKingShelter(const bitMap * const attackedSquares) const
+{
+	constexpr eCastle castleOO = c ? bCastleOO : wCastleOO;
+	constexpr eCastle castleOOO = c ? bCastleOOO : wCastleOOO;
+	constexpr bitboardIndex theirPieces = c ? whitePieces : blackPieces;
+	const state& st = getActualState();
+
+	Score shelter = evalShieldStorm<c>(getSquareOfThePiece( c ? blackKing : whiteKing ));
+
+	if( st.hasCastleRight( castleOO )
+		&& !(attackedSquares[theirPieces] & getCastleKingPath(castleOO))
+		&& !moreThanOneBit(_CastlePathOccupancyBitmap(castleOO))
+		)
+	{
+		shelter = std::max( evalShieldStorm<c>( c ? G8 : G1 ), shelter);
+	}
+
+	if( st.hasCastleRight( castleOOO )
+		&& !(attackedSquares[theirPieces] & getCastleKingPath(castleOOO))
+		&& !moreThanOneBit(_CastlePathOccupancyBitmap(castleOOO))
+		)
+	{
+		shelter = std::max( evalShieldStorm<c>( c ? C8 : C1 ), shelter);
+	}
+	return shelter;
 }
 
 /*! \brief do a pretty simple evalutation
@@ -693,6 +906,27 @@ simdScore Position::calcPawnValues(bitMap& weakPawns, bitMap& passedPawns, bitMa
 template<bool trace>
 Score Position::eval(void) const
 {
+	bool exact;
+	return _eval<trace, false>( -SCORE_INFINITE, SCORE_INFINITE, exact );
+}
+
+/*! \brief evaluation returning early when the remaining terms can't bring the score back inside the alpha beta window
+	\param exact set to false when the returned value is only an estimate, farther than a lazy margin from the window
+*/
+Score Position::eval(const Score alpha, const Score beta, bool& exact) const
+{
+	return _eval<false, true>( alpha, beta, exact );
+}
+
+template<bool trace, bool lazy>
+Score Position::_eval(const Score alpha, const Score beta, bool& exact) const
+{
+	exact = true;
+
+	if( !trace && _nnueActive )
+	{
+		return _evalNnue();
+	}
 
 	const state &st = getActualState();
 
@@ -718,43 +952,8 @@ Score Position::eval(void) const
 
 	
 	
-	kingRing[white] = 0;
-	if( st.getNonPawnValue()[ 2 ] >= Position::pieceValue[Knights][0] + Position::pieceValue[Rooks][0] )
-	{
-		tSquare k = getSquareOfThePiece(whiteKing);
-		if( getRankOf(k) == RANK1 )
-		{
-			k += north;
-		}
-		if( getFileOf(k) == FILEA )
-		{
-			k += est;
-		}
-		if( getFileOf(k) == FILEH )
-		{
-			k += ovest;
-		}
-		kingRing[white] = Movegen::attackFrom<whiteKing>(k) | bitSet( k );
-	}
-
-	kingRing[black] = 0;
-	if( st.getNonPawnValue()[ 0 ] >= Position::pieceValue[Knights][0] + Position::pieceValue[Rooks][0] )
-	{
-		tSquare k = getSquareOfThePiece(blackKing);
-		if( getRankOf(k) == RANK8 )
-		{
-			k += sud;
-		}
-		if( getFileOf(k) == FILEA )
-		{
-			k += est;
-		}
-		if( getFileOf(k) == FILEH )
-		{
-			k += ovest;
-		}
-		kingRing[black] = Movegen::attackFrom<blackKing>(k) | bitSet( k );
-	}
+	kingRing[white] = calcKingRing<white>();
+	kingRing[black] = calcKingRing<black>();
 
 
 	// todo modificare valori material value & pst
@@ -768,14 +967,14 @@ Score Position::eval(void) const
 	//-----------------------------------------------------
 
 
-	const materialStruct* const materialData = getMaterialData();
-	if( materialData )
+	const materialEntry& materialData = getMaterialData();
+	if( materialData.hasEndgame )
 	{
-		bool (Position::*pointer)(Score &) const = materialData->pointer;
-		switch(materialData->type)
+		bool (Position::*pointer)(Score &) const = materialData.pointer;
+		switch(materialData.type)
 		{
 			case materialStruct::type::exact:
-				return isBlackTurn() ? -materialData->val : materialData->val;
+				return isBlackTurn() ? -materialData.val : materialData.val;
 				break;
 			case materialStruct::type::multiplicativeFunction:
 			{
@@ -796,22 +995,18 @@ Score Position::eval(void) const
 				break;
 			}
 			case materialStruct::type::saturationH:
-				highSat = materialData->val;
+				highSat = materialData.val;
 				break;
 			case materialStruct::type::saturationL:
-				lowSat = materialData->val;
+				lowSat = materialData.val;
 				break;
 		}
 	}
-	else
+	else if( materialData.loneKing )
 	{
-		// analize k and pieces vs king
-		if( (bitCnt(getBitmap(whitePieces) )== 1 && bitCnt(getBitmap(blackPieces) )> 1) || (bitCnt(getBitmap(whitePieces) )> 1 && bitCnt(getBitmap(blackPieces) )== 1) )
-		{
-			Score r;
-			evalKxvsK(r);
-			return isBlackTurn() ? -r : r;
-		}
+		Score r;
+		evalKxvsK(r);
+		return isBlackTurn() ? -r : r;
 	}
 
 
@@ -834,38 +1029,16 @@ Score Position::eval(void) const
 	//---------------------------------------------
 	//	bishop pair
 
-	if( getPieceCount(whiteBishops) >= 2 )
+	if( hasBishopPair<white>() )
 	{
-		if( (getBitmap(whiteBishops) & getColorBitmap(white)) && (getBitmap(whiteBishops) & getColorBitmap(black) ) )
-		{
-			res += bishopPair;
-		}
+		res += bishopPair;
 	}
 
-	if( getPieceCount(blackBishops) >= 2 )
+	if( hasBishopPair<black>() )
 	{
-		if( (getBitmap(blackBishops) & getColorBitmap(white)) && (getBitmap(blackBishops) & getColorBitmap(black) ) )
-		{
-			res -= bishopPair;
-		}
-	}
-	if( getPieceCount(blackPawns) + getPieceCount(whitePawns) == 0 )
-	{
-		if((int)getPieceCount(whiteQueens) - (int)getPieceCount(blackQueens) == 1
-				&& (int)getPieceCount(blackRooks) - (int)getPieceCount(whiteRooks) == 1
-				&& (int)getPieceCount(blackBishops) + (int)getPieceCount(blackKnights) - (int)getPieceCount(whiteBishops) - (int)getPieceCount(whiteKnights) == 2)
-		{
-			res += queenVsRook2MinorsImbalance;
-
-		}
-		else if((int)getPieceCount(whiteQueens) - (int)getPieceCount(blackQueens) == -1
-				&& (int)getPieceCount(blackRooks) - (int)getPieceCount(whiteRooks) == -1
-				&& (int)getPieceCount(blackBishops) + (int)getPieceCount(blackKnights) - (int)getPieceCount(whiteBishops) -(int)getPieceCount(whiteKnights) == -2)
-		{
-			res -= queenVsRook2MinorsImbalance;
-
-		}
+		res -= bishopPair;
 	}
+	res += materialData.imbalance;
 
 	if(trace)
 	{
@@ -906,23 +1079,8 @@ Score Position::eval(void) const
 	// center control
 	//---------------------------------------------
 
-	if( attackedSquares[whitePawns] & centerBitmap )
-	{
-		res += (int)bitCnt( attackedSquares[whitePawns] & centerBitmap ) * pawnCenterControl;
-	}
-	if( attackedSquares[whitePawns] & bigCenterBitmap )
-	{
-		res += (int)bitCnt( attackedSquares[whitePawns] & bigCenterBitmap )* pawnBigCenterControl;
-	}
-
-	if( attackedSquares[blackPawns] & centerBitmap )
-	{
-		res -= (int)bitCnt( attackedSquares[blackPawns] & centerBitmap ) * pawnCenterControl;
-	}
-	if( attackedSquares[blackPawns] & bigCenterBitmap )
-	{
-		res -= (int)bitCnt( attackedSquares[blackPawns] & bigCenterBitmap ) * pawnBigCenterControl;
-	}
+	res += evalCenterControl( attackedSquares[whitePawns] );
+	res -= evalCenterControl( attackedSquares[blackPawns] );
 
 	if(trace)
 	{
@@ -933,6 +1091,16 @@ Score Position::eval(void) const
 	}
 
 
+	// cheap terms are done, the pieces cost the most. The passed pawn terms can swing the score too much to guess it before them
+	if( lazy && !passedPawns )
+	{
+		if( Score estimate; _isLazyCutoff( res, materialData.gamePhase, mulCoeff, lowSat, highSat, lazyMarginPieces, alpha, beta, estimate ) )
+		{
+			exact = false;
+			return estimate;
+		}
+	}
+
 	//-----------------------------------------
 	//	blocked pawns
 	//-----------------------------------------
@@ -1014,8 +1182,8 @@ Score Position::eval(void) const
 	}
 
 
-	attackedSquares[whiteKing] = Movegen::attackFrom<whiteKing>(getSquareOfThePiece(whiteKing));
-	attackedSquares[blackKing] = Movegen::attackFrom<blackKing>(getSquareOfThePiece(blackKing));
+	attackedSquares[whiteKing] = st.getAttacks(whiteKing);
+	attackedSquares[blackKing] = st.getAttacks(blackKing);
 
 	attackedSquares[whitePieces] = attackedSquares[whiteKing]
 								| attackedSquares[whiteKnights]
@@ -1054,29 +1222,27 @@ Score Position::eval(void) const
 	}
 	//todo attacked squares
 
+	if( lazy )
+	{
+		if( Score estimate; _isLazyCutoff( res, materialData.gamePhase, mulCoeff, lowSat, highSat, lazyMarginThreats, alpha, beta, estimate ) )
+		{
+			exact = false;
+			return estimate;
+		}
+	}
+
 	//---------------------------------------
 	//	space
 	//---------------------------------------
-	// white pawns
-	bitMap spacew = getBitmap(whitePawns) & spaceMask;
-	spacew |= spacew >> 8;
-	spacew |= spacew >> 16;
-	spacew |= spacew >> 32;
-	spacew &= ~attackedSquares[blackPieces];
-
-	// black pawns
-	bitMap spaceb = getBitmap(blackPawns) & spaceMask;
-	spaceb |= spaceb << 8;
-	spaceb |= spaceb << 16;
-	spaceb |= spaceb << 32;
-	spaceb &= ~attackedSquares[whitePieces];
-
-	res += ( (int)bitCnt(spacew) - (int)bitCnt(spaceb) ) * spaceBonus;
+	const int spacew = calcSpace<white>( attackedSquares );
+	const int spaceb = calcSpace<black>( attackedSquares );
+
+	res += ( spacew - spaceb ) * spaceBonus;
 
 	if(trace)
 	{
-		wScore = (int)bitCnt(spacew) * spaceBonus;
-		bScore = (int)bitCnt(spaceb) * spaceBonus;
+		wScore = spacew * spaceBonus;
+		bScore = spaceb * spaceBonus;
 		sync_cout << std::setw(20) << "space" << " |"
 				  << std::setw(6)  << (wScore[0])/10000.0 << " "
 				  << std::setw(6)  << (wScore[1])/10000.0 << " |"
@@ -1095,86 +1261,8 @@ Score Position::eval(void) const
 	//--------------------------------------
 	//	weak pieces
 	//--------------------------------------
-	wScore = simdScore{0,0,0,0};
-	bScore = simdScore{0,0,0,0};
-
-	bitMap pawnAttackedPieces = getBitmap( whitePieces ) & attackedSquares[ blackPawns ];
-	while(pawnAttackedPieces)
-	{
-		tSquare attacked = iterateBit( pawnAttackedPieces );
-		wScore -= attackedByPawnPenalty[ getPieceTypeAt(attacked) ];
-	}
-
-	// todo fare un weak piece migliore:qualsiasi pezzo attaccato riceve un malus dipendente dal suo pi debole attaccante e dal suo valore.
-	// volendo anche da quale pezzo  difeso
-	bitMap undefendedMinors =  (getBitmap(whiteKnights) | getBitmap(whiteBishops))  & ~attackedSquares[whitePieces];
-	if (undefendedMinors)
-	{
-		wScore -= undefendedMinorPenalty;
-	}
-	bitMap weakPieces = getBitmap(whitePieces) & attackedSquares[blackPieces] & ~attackedSquares[whitePawns];
-	while(weakPieces)
-	{
-		tSquare sq = iterateBit(weakPieces);
-
-		bitboardIndex attackedPieceType = getPieceTypeAt(sq);
-		bitboardIndex attackingPiece = blackPawns;
-		for(; attackingPiece >= blackKing; attackingPiece = (bitboardIndex)(attackingPiece - 1) )
-		{
-			if( isSquareSet( attackedSquares[ attackingPiece ], sq ) )
-			{
-				wScore -= weakPiecePenalty[ attackedPieceType ][ getPieceType( attackingPiece ) ];
-				break;
-			}
-		}
-
-	}
-	weakPieces =   getBitmap(whitePawns)
-		& ~attackedSquares[whitePieces]
-		& attackedSquares[blackKing];
-
-	if(weakPieces)
-	{
-		wScore -= weakPawnAttackedByKing;
-	}
-
-	pawnAttackedPieces = getBitmap( blackPieces ) & attackedSquares[ whitePawns ];
-	while(pawnAttackedPieces)
-	{
-		tSquare attacked = iterateBit( pawnAttackedPieces );
-		bScore -= attackedByPawnPenalty[ getPieceTypeAt(attacked) ];
-	}
-
-	undefendedMinors =  (getBitmap(blackKnights) | getBitmap(blackBishops))  & ~attackedSquares[blackPieces];
-	if (undefendedMinors)
-	{
-		bScore -= undefendedMinorPenalty;
-	}
-	weakPieces = getBitmap(blackPieces) & attackedSquares[whitePieces] & ~attackedSquares[blackPawns];
-	while(weakPieces)
-	{
-		tSquare sq = iterateBit(weakPieces);
-
-		bitboardIndex attackedPieceType = getPieceTypeAt(sq);
-		bitboardIndex attackingPiece = whitePawns;
-		for(; attackingPiece >= whiteKing; attackingPiece = (bitboardIndex)(attackingPiece - 1) )
-		{
-			if( isSquareSet( attackedSquares[ attackingPiece ], sq ) )
-			{
-				bScore -= weakPiecePenalty[ attackedPieceType ][ getPieceType(attackingPiece) ];
-				break;
-			}
-		}
-	}
-
-	weakPieces =   getBitmap(blackPawns)
-		& ~attackedSquares[blackPieces]
-		& attackedSquares[whiteKing];
-
-	if(weakPieces)
-	{
-		bScore -= weakPawnAttackedByKing;
-	}
+	wScore = evalThreats<white>( attackedSquares );
+	bScore = evalThreats<black>( attackedSquares );
 
 
 
@@ -1202,45 +1290,13 @@ Score Position::eval(void) const
 	//--------------------------------------
 	Score kingSafety[2] = {0, 0};
 
-	kingSafety[white] = evalShieldStorm<white>(getSquareOfThePiece(whiteKing));
-
-	if( st.hasCastleRight( wCastleOO )
-		&& !(attackedSquares[blackPieces] & getCastleKingPath(wCastleOO))
-		&& !moreThanOneBit(_CastlePathOccupancyBitmap(wCastleOO))
-		)
-	{
-		kingSafety[white] = std::max( evalShieldStorm<white>(G1), kingSafety[white]);
-	}
-
-	if( st.hasCastleRight( wCastleOOO )
-		&& !(attackedSquares[blackPieces] & getCastleKingPath(wCastleOOO))
-		&& !moreThanOneBit(_CastlePathOccupancyBitmap(wCastleOOO))
-		)
-	{
-		kingSafety[white] = std::max( evalShieldStorm<white>(C1), kingSafety[white]);
-	}
+	kingSafety[white] = evalKingShelter<white>( attackedSquares );
 	if(trace)
 	{
 		wScore = simdScore{ kingSafety[white], 0, 0, 0};
 	}
 
-	kingSafety[black] = evalShieldStorm<black>(getSquareOfThePiece(blackKing));
-
-	if( st.hasCastleRight( bCastleOO )
-		&& !(attackedSquares[whitePieces] & getCastleKingPath(bCastleOO))
-		&& !moreThanOneBit(_CastlePathOccupancyBitmap(bCastleOO))
-		)
-	{
-		kingSafety[black] = std::max( evalShieldStorm<black>(G8), kingSafety[black]);
-	}
-
-	if( st.hasCastleRight( bCastleOOO )
-		&& !(attackedSquares[whitePieces] & getCastleKingPath(bCastleOOO))
-		&& !moreThanOneBit(_CastlePathOccupancyBitmap(bCastleOOO))
-		)
-	{
-		kingSafety[black] = std::max(evalShieldStorm<black>(C8), kingSafety[black]);
-	}
+	kingSafety[black] = evalKingShelter<black>( attackedSquares );
 	if(trace)
 	{
 		bScore = simdScore{ kingSafety[black], 0, 0, 0};
@@ -1320,7 +1376,14 @@ Score Position::eval(void) const
 	//--------------------------------------
 	//	finalizing
 	//--------------------------------------
-	signed int gamePhase = getGamePhase( st );
+	return _finalizeScore( res, materialData.gamePhase, mulCoeff, lowSat, highSat );
+
+}
+
+/*! \brief interpolate the opening and endgame scores and return the saturated value from the point of view of the side to move
+*/
+inline Score Position::_finalizeScore(const simdScore& res, const signed int gamePhase, const Score mulCoeff, const Score lowSat, const Score highSat) const
+{
 	// mulCoeff will multiplicate only endgame
 	signed long long r = (((signed long long)res[0]) * (65536 - gamePhase)) + (((signed long long)res[1]) * gamePhase * mulCoeff / 256);
 
@@ -1331,7 +1394,14 @@ Score Position::eval(void) const
 	score = std::max(lowSat,score);
 
 	return isBlackTurn() ? -score : score;
+}
 
+/*! \brief tell whether the partial score is so far from the window that the missing terms can't bring it back
+*/
+inline bool Position::_isLazyCutoff(const simdScore& res, const signed int gamePhase, const Score mulCoeff, const Score lowSat, const Score highSat, const Score margin, const Score alpha, const Score beta, Score& estimate) const
+{
+	estimate = _finalizeScore( res, gamePhase, mulCoeff, lowSat, highSat );
+	return estimate - margin >= beta || estimate + margin <= alpha;
 }
 
 template Score Position::eval<false>(void) const;
@@ -0,0 +1,151 @@
+/*
+	This file is part of Vajolet.
+
+    Vajolet is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    Vajolet is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with Vajolet.  If not, see <http://www.gnu.org/licenses/>
+*/
+
+#ifndef KOGGESTONE_H_
+#define KOGGESTONE_H_
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+#include "bitops.h"
+
+/*! \brief attacks of a whole set of sliders, calculated with Kogge-Stone occluded fills
+
+	the four directions of a slider are filled at the same time, one per 64 bit lane. The avx2 kernel
+	keeps the four lanes in one register using the variable shifts, the sse2 kernel uses two registers
+	with one left and one right shift each. The result is the union of the attacks of all the pieces in the set,
+	the same of or-ing the magic lookups of every piece.
+*/
+class KoggeStone
+{
+public:
+	inline static bitMap rookAttacks(const bitMap rooks, const bitMap occupancy)
+	{
+#if defined(__AVX2__)
+		// north, east, south, west
+		return _fill( rooks, occupancy, _mm256_set_epi64x( 64, 64, 1, 8 ), _mm256_set_epi64x( 1, 8, 64, 64 ), _mm256_set_epi64x( notH, -1, notA, -1 ) );
+#elif defined(__SSE2__)
+		return _fill<8>( rooks, occupancy, _mm_set1_epi64x( -1 ) ) | _fill<1>( rooks, occupancy, _mm_set_epi64x( notH, notA ) );
+#else
+		return _fill<8>( rooks, occupancy, -1 ) | _fill<-8>( rooks, occupancy, -1 ) | _fill<1>( rooks, occupancy, notA ) | _fill<-1>( rooks, occupancy, notH );
+#endif
+	}
+
+	inline static bitMap bishopAttacks(const bitMap bishops, const bitMap occupancy)
+	{
+#if defined(__AVX2__)
+		// north east, north west, south east, south west
+		return _fill( bishops, occupancy, _mm256_set_epi64x( 64, 64, 7, 9 ), _mm256_set_epi64x( 9, 7, 64, 64 ), _mm256_set_epi64x( notH, notA, notH, notA ) );
+#elif defined(__SSE2__)
+		return _fill<9>( bishops, occupancy, _mm_set_epi64x( notH, notA ) ) | _fill<7>( bishops, occupancy, _mm_set_epi64x( notA, notH ) );
+#else
+		return _fill<9>( bishops, occupancy, notA ) | _fill<7>( bishops, occupancy, notH ) | _fill<-7>( bishops, occupancy, notA ) | _fill<-9>( bishops, occupancy, notH );
+#endif
+	}
+
+	inline static bitMap queenAttacks(const bitMap queens, const bitMap occupancy)
+	{
+		return rookAttacks( queens, occupancy ) | bishopAttacks( queens, occupancy );
+	}
+
+	static const char * kernelName()
+	{
+#if defined(__AVX2__)
+		return "avx2";
+#elif defined(__SSE2__)
+		return "sse2";
+#else
+		return "scalar";
+#endif
+	}
+
+private:
+	static constexpr long long notA = (long long)0xfefefefefefefefeULL;	/*!< squares that can be reached going east without wrapping*/
+	static constexpr long long notH = (long long)0x7f7f7f7f7f7f7f7fULL;			/*!< squares that can be reached going west without wrapping*/
+
+#if defined(__AVX2__)
+	/*! \brief shift every lane left by the left count and right by the right count, a count of 64 clears the lane */
+	inline static __m256i _shift(const __m256i b, const __m256i left, const __m256i right)
+	{
+		return _mm256_or_si256( _mm256_sllv_epi64( b, left ), _mm256_srlv_epi64( b, right ) );
+	}
+
+	inline static bitMap _fill(const bitMap sliders, const bitMap occupancy, const __m256i left, const __m256i right, const __m256i mask)
+	{
+		const __m256i left2 = _mm256_add_epi64( left, left ), left4 = _mm256_add_epi64( left2, left2 );
+		const __m256i right2 = _mm256_add_epi64( right, right ), right4 = _mm256_add_epi64( right2, right2 );
+
+		__m256i gen = _mm256_set1_epi64x( (long long)sliders );
+		__m256i pro = _mm256_andnot_si256( _mm256_set1_epi64x( (long long)occupancy ), mask );
+
+		gen = _mm256_or_si256( gen, _mm256_and_si256( pro, _shift( gen, left, right ) ) );
+		pro = _mm256_and_si256( pro, _shift( pro, left, right ) );
+		gen = _mm256_or_si256( gen, _mm256_and_si256( pro, _shift( gen, left2, right2 ) ) );
+		pro = _mm256_and_si256( pro, _shift( pro, left2, right2 ) );
+		gen = _mm256_or_si256( gen, _mm256_and_si256( pro, _shift( gen, left4, right4 ) ) );
+
+		const __m256i att = _mm256_and_si256( _shift( gen, left, right ), mask );
+		const __m128i res = _mm_or_si128( _mm256_castsi256_si128( att ), _mm256_extracti128_si256( att, 1 ) );
+		return (bitMap)_mm_cvtsi128_si64( _mm_or_si128( res, _mm_unpackhi_epi64( res, res ) ) );
+	}
+#elif defined(__SSE2__)
+	/*! \brief shift the low lane left and the high lane right */
+	template<int s> inline static __m128i _shift(const __m128i b)
+	{
+		const __m128i low = _mm_set_epi64x( 0, -1 );
+		return _mm_or_si128( _mm_and_si128( _mm_slli_epi64( b, s ), low ), _mm_andnot_si128( low, _mm_srli_epi64( b, s ) ) );
+	}
+
+	/*! \brief fill the direction going left by s in the low lane and the one going right by s in the high lane */
+	template<int s> inline static bitMap _fill(const bitMap sliders, const bitMap occupancy, const __m128i mask)
+	{
+		__m128i gen = _mm_set1_epi64x( (long long)sliders );
+		__m128i pro = _mm_andnot_si128( _mm_set1_epi64x( (long long)occupancy ), mask );
+
+		gen = _mm_or_si128( gen, _mm_and_si128( pro, _shift<s>( gen ) ) );
+		pro = _mm_and_si128( pro, _shift<s>( pro ) );
+		gen = _mm_or_si128( gen, _mm_and_si128( pro, _shift<2 * s>( gen ) ) );
+		pro = _mm_and_si128( pro, _shift<2 * s>( pro ) );
+		gen = _mm_or_si128( gen, _mm_and_si128( pro, _shift<4 * s>( gen ) ) );
+
+		const __m128i att = _mm_and_si128( _shift<s>( gen ), mask );
+		return (bitMap)_mm_cvtsi128_si64( _mm_or_si128( att, _mm_unpackhi_epi64( att, att ) ) );
+	}
+#else
+	/*! \brief shift left by s, or right by -s */
+	template<int s> inline static bitMap _shift(const bitMap b)
+	{
+		return s > 0 ? b << ( s & 63 ) : b >> ( -s & 63 );
+	}
+
+	template<int s> inline static bitMap _fill(bitMap gen, const bitMap occupancy, const bitMap mask)
+	{
+		bitMap pro = ~occupancy & mask;
+		gen |= pro & _shift<s>( gen );
+		pro &= _shift<s>( pro );
+		gen |= pro & _shift<2 * s>( gen );
+		pro &= _shift<2 * s>( pro );
+		gen |= pro & _shift<4 * s>( gen );
+		return _shift<s>( gen ) & mask;
+	}
+#endif
+};
+
+#endif /* KOGGESTONE_H_ */
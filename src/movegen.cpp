@@ -42,7 +42,15 @@ void Movegen::_setBit( bitMap& b, tFile file, tRank rank )
 
 void Movegen::initMovegenConstant(void){
 	
+#if defined(COMPACT_MAGIC_ATTACKS)
 	initmagicmoves();
+	CompactMagics::init();
+#elif defined(USE_PEXT)
+	// movegen doesn't read the magic tables, the benchmark and the tests fill them when they need them
+	PextAttacks::init();
+#else
+	initmagicmoves();
+#endif
 	
 	struct coord{ int x; int y;};
 	std::list<coord> pawnsAttack[2] ={{{-1,1},{1,1}},{{-1,-1},{1,-1}}};
@@ -266,12 +274,14 @@ inline void Movegen::_generateKingMoves( MoveList<MAX_MOVE_PER_POSITION>& ml, co
 	
 	m.setFrom( kingSquare );
 
-	bitMap moves = _attackFromKing(kingSquare,occupiedSquares) & kingTarget;
+	const state& s = _pos.getActualState();
+	bitMap moves = _attackFromKing(kingSquare,occupiedSquares) & kingTarget & ~s.getAttacks( s.getPiecesOfOtherPlayer() );
 
 	while(moves)
 	{
 		tSquare to = iterateBit(moves);
-		if( !(_pos.getAttackersTo(to, occupiedSquares & ~_pos.getOurBitmap(King)) & enemy) )
+		// when not in check, removing the king cannot uncover any new attack
+		if( !s.isInCheck() || !(_pos.getAttackersTo(to, occupiedSquares & ~_pos.getOurBitmap(King)) & enemy) )
 		{
 			m.setTo( to );
 			_insertStandardMove<type>( ml, m );
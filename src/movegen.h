@@ -20,8 +20,11 @@
 #define MOVEGEN_H_
 
 #include "bitops.h"
+#include "compactMagics.h"
 #include "magicmoves.h"
 #include "moveList.h"
+#include "pextAttacks.h"
+#include "vajolet.h"
 
 class Position;
 
@@ -97,6 +100,18 @@ public:
 		return _attackFromBishop(from, 0);
 	}
 	
+	/*! \brief name of the slider attack table compiled in the build */
+	static const char * sliderTableName()
+	{
+#if defined(COMPACT_MAGIC_ATTACKS)
+		return "compact magic";
+#elif defined(USE_PEXT)
+		return "pext";
+#else
+		return "magic";
+#endif
+	}
+
 	/* non static methods */
 	template<Movegen::genType type>	void generateMoves( MoveList<MAX_MOVE_PER_POSITION>& ml) const;
 
@@ -113,13 +128,25 @@ private:
 	inline static bitMap _attackFromRook(const tSquare from, const bitMap& occupancy)
 	{
 		assert(from <squareNumber);
+#if defined(COMPACT_MAGIC_ATTACKS)
+		return CompactMagics::rookAttacks(from, occupancy);
+#elif defined(USE_PEXT)
+		return PextAttacks::rookAttacks(from, occupancy);
+#else
 		return *(magicmoves_r_indices[from]+(((occupancy&magicmoves_r_mask[from])*magicmoves_r_magics[from])>>magicmoves_r_shift[from]));
+#endif
 	}
 
 	inline static bitMap _attackFromBishop(const tSquare from, const bitMap& occupancy)
 	{
 		assert(from <squareNumber);
+#if defined(COMPACT_MAGIC_ATTACKS)
+		return CompactMagics::bishopAttacks(from, occupancy);
+#elif defined(USE_PEXT)
+		return PextAttacks::bishopAttacks(from, occupancy);
+#else
 		return *(magicmoves_b_indices[from]+(((occupancy&magicmoves_b_mask[from])*magicmoves_b_magics[from])>>magicmoves_b_shift[from]));
+#endif
 	}
 	
 	inline static bitMap _attackFromQueen(const tSquare from, const bitMap& occupancy)
@@ -269,14 +269,14 @@ short int MovePicker::setupQuiescentSearch( const bool inCheck, const int depth
 	if( inCheck)
 	{
 		_stagedGeneratorState = eStagedGeneratorState::getTTevasion;
-		return -1;
+		return getQuiescentSearchDepth( inCheck, depth );
 	}
 	else
 	{
 		if( depth >= 0 )
 		{
 			_stagedGeneratorState = eStagedGeneratorState::getQsearchTTquiet;
-			return -1;
+			return getQuiescentSearchDepth( inCheck, depth );
 		}
 		else
 		{
@@ -286,7 +286,7 @@ short int MovePicker::setupQuiescentSearch( const bool inCheck, const int depth
 			{
 				_ttMove = Move::NOMOVE;
 			}
-			return -2;
+			return getQuiescentSearchDepth( inCheck, depth );
 		}
 	}
 }
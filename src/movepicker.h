@@ -39,6 +39,9 @@ public:
 	explicit MovePicker(const Position & p, const SearchData& sd = _defaultSearchData, unsigned int ply = 0, const Move & ttm = Move::NOMOVE);
 	// todo transform them into constructor? create base class and derived?
 	short int setupQuiescentSearch( const bool inCheck, const int depth );
+	/*! \brief depth in plies of the quiescence search node, as returned by setupQuiescentSearch
+	*/
+	static short int getQuiescentSearchDepth( const bool inCheck, const int depth ){ return ( inCheck || depth >= 0 ) ? -1 : -2; }
 	void setupProbCutSearch( const bitboardIndex capturePiece );
 	
 	//--------------------------------------------------------
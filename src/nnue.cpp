@@ -0,0 +1,291 @@
+/*
+	This file is part of Vajolet.
+
+    Vajolet is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    Vajolet is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with Vajolet.  If not, see <http://www.gnu.org/licenses/>
+*/
+
+#include <algorithm>
+#include <cassert>
+#include <fstream>
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#elif defined(__SSE4_1__)
+#include <smmintrin.h>
+#endif
+
+#include "nnue.h"
+#include "position.h"
+
+struct alignas(32) nnue::network
+{
+	// the rows used by the simd kernels come first, to keep them aligned
+	int16_t ftBias[halfDimensions];
+	int16_t ftWeights[inputs][halfDimensions];
+	int8_t hiddenWeights[hiddenDimensions][2 * halfDimensions];
+	int32_t hiddenBias[hiddenDimensions];
+	int32_t outputBias;
+	int32_t outputScale;
+	int8_t outputWeights[hiddenDimensions];
+};
+
+nnue::nnue() = default;
+nnue::~nnue() = default;
+
+//---------------------------------------------
+//	kernels
+//---------------------------------------------
+namespace
+{
+	inline void addWeights( int16_t * const acc, const int16_t * const w )
+	{
+#if defined(__AVX2__)
+		for( unsigned int i = 0; i < nnue::halfDimensions; i += 16 )
+		{
+			__m256i * const a = reinterpret_cast<__m256i *>( acc + i );
+			_mm256_store_si256( a, _mm256_add_epi16( _mm256_load_si256( a ), _mm256_load_si256( reinterpret_cast<const __m256i *>( w + i ) ) ) );
+		}
+#elif defined(__SSE4_1__)
+		for( unsigned int i = 0; i < nnue::halfDimensions; i += 8 )
+		{
+			__m128i * const a = reinterpret_cast<__m128i *>( acc + i );
+			_mm_store_si128( a, _mm_add_epi16( _mm_load_si128( a ), _mm_load_si128( reinterpret_cast<const __m128i *>( w + i ) ) ) );
+		}
+#else
+		for( unsigned int i = 0; i < nnue::halfDimensions; ++i )
+		{
+			acc[i] += w[i];
+		}
+#endif
+	}
+
+	inline void subWeights( int16_t * const acc, const int16_t * const w )
+	{
+#if defined(__AVX2__)
+		for( unsigned int i = 0; i < nnue::halfDimensions; i += 16 )
+		{
+			__m256i * const a = reinterpret_cast<__m256i *>( acc + i );
+			_mm256_store_si256( a, _mm256_sub_epi16( _mm256_load_si256( a ), _mm256_load_si256( reinterpret_cast<const __m256i *>( w + i ) ) ) );
+		}
+#elif defined(__SSE4_1__)
+		for( unsigned int i = 0; i < nnue::halfDimensions; i += 8 )
+		{
+			__m128i * const a = reinterpret_cast<__m128i *>( acc + i );
+			_mm_store_si128( a, _mm_sub_epi16( _mm_load_si128( a ), _mm_load_si128( reinterpret_cast<const __m128i *>( w + i ) ) ) );
+		}
+#else
+		for( unsigned int i = 0; i < nnue::halfDimensions; ++i )
+		{
+			acc[i] -= w[i];
+		}
+#endif
+	}
+
+	/*! \brief clipped relu, int16 -> [0, 127] */
+	inline void clip( const int16_t * const in, int8_t * const out )
+	{
+#if defined(__AVX2__)
+		const __m256i zero = _mm256_setzero_si256();
+		for( unsigned int i = 0; i < nnue::halfDimensions; i += 32 )
+		{
+			const __m256i a = _mm256_load_si256( reinterpret_cast<const __m256i *>( in + i ) );
+			const __m256i b = _mm256_load_si256( reinterpret_cast<const __m256i *>( in + i + 16 ) );
+			// packs works on 128 bit lanes, the permute restores the order
+			const __m256i packed = _mm256_permute4x64_epi64( _mm256_packs_epi16( a, b ), 0xD8 );
+			_mm256_store_si256( reinterpret_cast<__m256i *>( out + i ), _mm256_max_epi8( packed, zero ) );
+		}
+#elif defined(__SSE4_1__)
+		const __m128i zero = _mm_setzero_si128();
+		for( unsigned int i = 0; i < nnue::halfDimensions; i += 16 )
+		{
+			const __m128i a = _mm_load_si128( reinterpret_cast<const __m128i *>( in + i ) );
+			const __m128i b = _mm_load_si128( reinterpret_cast<const __m128i *>( in + i + 8 ) );
+			_mm_store_si128( reinterpret_cast<__m128i *>( out + i ), _mm_max_epi8( _mm_packs_epi16( a, b ), zero ) );
+		}
+#else
+		for( unsigned int i = 0; i < nnue::halfDimensions; ++i )
+		{
+			out[i] = int8_t( std::min( std::max( int( in[i] ), 0 ), 127 ) );
+		}
+#endif
+	}
+
+	/*! \brief dot product of n [0, 127] inputs and n int8 weights, n multiple of 32 */
+	inline int32_t dot( const int8_t * const in, const int8_t * const w, const unsigned int n )
+	{
+#if defined(__AVX2__)
+		const __m256i ones = _mm256_set1_epi16( 1 );
+		__m256i sum = _mm256_setzero_si256();
+		for( unsigned int i = 0; i < n; i += 32 )
+		{
+			// inputs are at most 127, so the pairwise sums of maddubs can't saturate
+			const __m256i p = _mm256_maddubs_epi16( _mm256_load_si256( reinterpret_cast<const __m256i *>( in + i ) ), _mm256_load_si256( reinterpret_cast<const __m256i *>( w + i ) ) );
+			sum = _mm256_add_epi32( sum, _mm256_madd_epi16( p, ones ) );
+		}
+		__m128i s = _mm_add_epi32( _mm256_castsi256_si128( sum ), _mm256_extracti128_si256( sum, 1 ) );
+		s = _mm_add_epi32( s, _mm_shuffle_epi32( s, 0x4E ) );
+		s = _mm_add_epi32( s, _mm_shuffle_epi32( s, 0xB1 ) );
+		return _mm_cvtsi128_si32( s );
+#elif defined(__SSE4_1__)
+		const __m128i ones = _mm_set1_epi16( 1 );
+		__m128i sum = _mm_setzero_si128();
+		for( unsigned int i = 0; i < n; i += 16 )
+		{
+			const __m128i p = _mm_maddubs_epi16( _mm_load_si128( reinterpret_cast<const __m128i *>( in + i ) ), _mm_load_si128( reinterpret_cast<const __m128i *>( w + i ) ) );
+			sum = _mm_add_epi32( sum, _mm_madd_epi16( p, ones ) );
+		}
+		sum = _mm_add_epi32( sum, _mm_shuffle_epi32( sum, 0x4E ) );
+		sum = _mm_add_epi32( sum, _mm_shuffle_epi32( sum, 0xB1 ) );
+		return _mm_cvtsi128_si32( sum );
+#else
+		int32_t sum = 0;
+		for( unsigned int i = 0; i < n; ++i )
+		{
+			sum += int32_t( in[i] ) * w[i];
+		}
+		return sum;
+#endif
+	}
+
+	template<typename T> bool readValues( std::ifstream& f, T * const dst, const size_t n )
+	{
+		return bool( f.read( reinterpret_cast<char *>( dst ), std::streamsize( n * sizeof(T) ) ) );
+	}
+}
+
+//---------------------------------------------
+//	network
+//---------------------------------------------
+bool nnue::load( const std::string& path )
+{
+	std::ifstream f( path, std::ios::binary );
+	if( !f )
+	{
+		return false;
+	}
+
+	uint32_t header[4];
+	if( !readValues( f, header, 4 )
+		|| header[0] != magic
+		|| header[1] != inputs
+		|| header[2] != halfDimensions
+		|| header[3] != hiddenDimensions )
+	{
+		return false;
+	}
+
+	std::unique_ptr<network> net( new network );
+	if( !readValues( f, &net->outputScale, 1 )
+		|| !readValues( f, net->ftBias, halfDimensions )
+		|| !readValues( f, &net->ftWeights[0][0], inputs * halfDimensions )
+		|| !readValues( f, net->hiddenBias, hiddenDimensions )
+		|| !readValues( f, &net->hiddenWeights[0][0], hiddenDimensions * 2 * halfDimensions )
+		|| !readValues( f, &net->outputBias, 1 )
+		|| !readValues( f, net->outputWeights, hiddenDimensions ) )
+	{
+		return false;
+	}
+
+	// trailing data means the file has been written for another architecture
+	if( f.peek() != std::ifstream::traits_type::eof() )
+	{
+		return false;
+	}
+
+	_net = std::move( net );
+	return true;
+}
+
+void nnue::unload()
+{
+	_net.reset();
+}
+
+unsigned int nnue::featureIndex( const Color perspective, const bitboardIndex piece, const tSquare sq )
+{
+	assert( isValidPiece( piece ) );
+	// the black perspective sees the board flipped and the colors swapped
+	const unsigned int relativeColor = unsigned( isBlackPiece( piece ) ) ^ unsigned( perspective );
+	const unsigned int relativeSquare = perspective == black ? sq ^ 56 : sq;
+	return ( relativeColor * 6 + unsigned( getPieceType( piece ) - King ) ) * 64 + relativeSquare;
+}
+
+void nnue::refresh( const Position& pos, nnueAccumulator& acc ) const
+{
+	assert( _net );
+	for( const Color c: { white, black } )
+	{
+		std::copy( _net->ftBias, _net->ftBias + halfDimensions, acc.values[c] );
+		for( bitboardIndex p = whiteKing; p <= blackPawns; p = bitboardIndex( p + 1 ) )
+		{
+			if( isValidPiece( p ) )
+			{
+				bitMap b = pos.getBitmap( p );
+				while( b )
+				{
+					addWeights( acc.values[c], _net->ftWeights[ featureIndex( c, p, iterateBit( b ) ) ] );
+				}
+			}
+		}
+	}
+	acc.computed = true;
+}
+
+void nnue::update( const nnueAccumulator& prev, nnueAccumulator& acc ) const
+{
+	assert( _net );
+	assert( prev.computed );
+	assert( acc.dirtyCount <= nnueAccumulator::maxDirtyPieces );
+	for( const Color c: { white, black } )
+	{
+		std::copy( prev.values[c], prev.values[c] + halfDimensions, acc.values[c] );
+		for( unsigned int i = 0; i < acc.dirtyCount; ++i )
+		{
+			const nnueAccumulator::dirtyPiece& d = acc.dirty[i];
+			if( d.from != squareNone )
+			{
+				subWeights( acc.values[c], _net->ftWeights[ featureIndex( c, d.piece, d.from ) ] );
+			}
+			if( d.to != squareNone )
+			{
+				addWeights( acc.values[c], _net->ftWeights[ featureIndex( c, d.piece, d.to ) ] );
+			}
+		}
+	}
+	acc.computed = true;
+}
+
+Score nnue::evaluate( const nnueAccumulator& acc, const Color sideToMove ) const
+{
+	assert( _net );
+	assert( acc.computed );
+
+	alignas(32) int8_t input[ 2 * halfDimensions ];
+	clip( acc.values[ sideToMove ], input );
+	clip( acc.values[ 1 - sideToMove ], input + halfDimensions );
+
+	alignas(32) int8_t hidden[ hiddenDimensions ];
+	for( unsigned int i = 0; i < hiddenDimensions; ++i )
+	{
+		const int32_t v = ( _net->hiddenBias[i] + dot( input, _net->hiddenWeights[i], 2 * halfDimensions ) ) >> hiddenShift;
+		hidden[i] = int8_t( std::min( std::max( v, 0 ), 127 ) );
+	}
+
+	int64_t out = _net->outputBias;
+	for( unsigned int i = 0; i < hiddenDimensions; ++i )
+	{
+		out += int32_t( hidden[i] ) * _net->outputWeights[i];
+	}
+	return Score( ( out * _net->outputScale ) >> outputShift );
+}
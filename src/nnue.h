@@ -0,0 +1,110 @@
+/*
+	This file is part of Vajolet.
+
+    Vajolet is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    Vajolet is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with Vajolet.  If not, see <http://www.gnu.org/licenses/>
+*/
+
+#ifndef NNUE_H_
+#define NNUE_H_
+
+#include <cstdint>
+#include <memory>
+#include <string>
+
+#include "bitBoardIndex.h"
+#include "score.h"
+#include "tSquare.h"
+
+class Position;
+struct nnueAccumulator;
+
+/*! \brief efficiently updatable neural network evaluation
+
+	the network is a feature transformer from 768 piece-square inputs (seen from each side) to two
+	accumulators of halfDimensions int16 values, followed by a clipped relu, an int8 hidden layer
+	and an int8 output neuron. The accumulators are updated incrementally by the moves.
+
+	file format, little endian:
+	uint32 magic ( "VNN1" ), uint32 inputs, uint32 halfDimensions, uint32 hiddenDimensions, int32 outputScale,
+	int16 ftBias[halfDimensions], int16 ftWeights[inputs][halfDimensions],
+	int32 hiddenBias[hiddenDimensions], int8 hiddenWeights[hiddenDimensions][2 * halfDimensions],
+	int32 outputBias, int8 outputWeights[hiddenDimensions]
+*/
+class nnue
+{
+public:
+	static constexpr uint32_t magic = 0x314E4E56; // "VNN1"
+	static constexpr unsigned int inputs = 2 * 6 * 64;	/*!< color, piece type, square*/
+	static constexpr unsigned int halfDimensions = 128;
+	static constexpr unsigned int hiddenDimensions = 32;
+	static constexpr int hiddenShift = 6;		/*!< right shift applied to the hidden layer before the clipped relu*/
+	static constexpr int outputShift = 10;		/*!< score = output * outputScale >> outputShift */
+
+	static nnue& getInstance()
+	{
+		static nnue instance;
+		return instance;
+	}
+
+	/*! \brief load a network file, on error the previous network is kept
+		\return true if the file has been loaded
+	*/
+	bool load( const std::string& path );
+	void unload();
+	bool isLoaded() const { return _net != nullptr; }
+
+	/*! \brief calc the accumulators of a position from scratch */
+	void refresh( const Position& pos, nnueAccumulator& acc ) const;
+	/*! \brief calc the accumulators of a position from the ones of the previous position and the changed pieces */
+	void update( const nnueAccumulator& prev, nnueAccumulator& acc ) const;
+	/*! \brief evaluate the position from the point of view of the side to move */
+	Score evaluate( const nnueAccumulator& acc, const Color sideToMove ) const;
+
+	static unsigned int featureIndex( const Color perspective, const bitboardIndex piece, const tSquare sq );
+
+	nnue(const nnue&) = delete;
+	nnue& operator=(const nnue&) = delete;
+	nnue(nnue&&) = delete;
+	nnue& operator=(nnue&&) = delete;
+
+private:
+	nnue();
+	~nnue();
+
+	struct network;
+	std::unique_ptr<network> _net;
+};
+
+/*! \brief feature transformer output of a position, stored alongside the state stack
+*/
+struct alignas(32) nnueAccumulator
+{
+	static constexpr unsigned int maxDirtyPieces = 3;
+	static constexpr unsigned int needRefresh = ~0u;	/*!< dirtyCount value of an accumulator whose changes are unknown*/
+
+	/*! \brief a piece moved by the move that generated the position, from or to is squareNone when the piece appears or disappears */
+	struct dirtyPiece
+	{
+		bitboardIndex piece;
+		tSquare from;
+		tSquare to;
+	};
+
+	int16_t values[2][nnue::halfDimensions];
+	dirtyPiece dirty[maxDirtyPieces];
+	unsigned int dirtyCount = needRefresh;
+	bool computed = false;
+};
+
+#endif
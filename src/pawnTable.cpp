@@ -0,0 +1,63 @@
+/*
+	This file is part of Vajolet.
+
+    Vajolet is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    Vajolet is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with Vajolet.  If not, see <http://www.gnu.org/licenses/>
+*/
+
+#include "pawnTable.h"
+#include "uciParameters.h"
+
+std::shared_ptr<pawnTable> pawnTable::create()
+{
+	if( uciParameters::sharedPawnHash )
+	{
+		// the shared table is resized only when no search is running, before the threads get their tables
+		static std::shared_ptr<pawnTable> shared = std::make_shared<pawnTable>( uciParameters::pawnHashSize );
+		shared->_shared = true;
+		if( shared->getSize() != uciParameters::pawnHashSize )
+		{
+			shared->setSize( uciParameters::pawnHashSize );
+		}
+		return shared;
+	}
+	return std::make_shared<pawnTable>( uciParameters::pawnHashSize );
+}
+
+void pawnTable::setSize(const unsigned int mbSize)
+{
+	_mbSize = mbSize;
+	uint64_t elements = 1;
+	while( elements * 2 * ( sizeof(pawnEntry) + 4 * sizeof(uint64_t) ) <= uint64_t( mbSize ) * 1024 * 1024 )
+	{
+		elements *= 2;
+	}
+	_mask = elements - 1;
+	_pawnTable = std::vector<pawnEntry>( elements );
+	_shieldStormMask = elements * 4 - 1;
+	_shieldStorm.reset( new std::atomic<uint64_t>[ elements * 4 ] );
+	clear();
+}
+
+void pawnTable::clear()
+{
+	for( auto& e: _pawnTable )
+	{
+		e.clear();
+	}
+	for( uint64_t i = 0; i <= _shieldStormMask; ++i )
+	{
+		// an empty entry matches only the keys with all the upper 32 bits set, as unlikely as any collision
+		_shieldStorm[i].store( 0xFFFFFFFF00000000ull, std::memory_order_relaxed );
+	}
+}
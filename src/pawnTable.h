@@ -21,28 +21,107 @@
 
 
 #include <array>
+#include <atomic>
 #include <cstdint>
+#include <memory>
+#include <vector>
 
 #include "bitBoardIndex.h"
 #include "bitops.h"
 #include "hashKey.h"
 #include "score.h"
+#include "transposition.h"
 
+/*! \brief pawn structure evaluation, stored as 64 bit words
+	the key is stored xored with a hash of all the data words, so an entry torn by two threads writing at the same time fails the key verification
+	and the table can be shared between threads without locks
+*/
 class pawnEntry
 {
 public:
-	HashKey key;
-	bitMap weakPawns;
-	bitMap passedPawns;
-	bitMap pawnAttacks[2];
-	bitMap weakSquares[2];
-	bitMap holes[2];
-	Score res[2];
+	enum word
+	{
+		weakPawns,
+		passedPawns,
+		whitePawnAttacks,
+		blackPawnAttacks,
+		whiteWeakSquares,
+		blackWeakSquares,
+		whiteHoles,
+		blackHoles,
+		score,			// middle game score in the low 32 bits, end game score in the high ones
+		wordNumber
+	};
+	using data = std::array<uint64_t, wordNumber>;
+
+	/*! \brief non linear hash of the data words, a plain xor would let correlated words of two entries cancel out
+	*/
+	static uint64_t fold(const data& d)
+	{
+		uint64_t f = 0;
+		for( auto w: d ) { f = ( f + w ) * 0x9E3779B97F4A7C15ull; }
+		return f ^ ( f >> 32 );
+	}
+
+	bool load(const uint64_t key, data& d) const
+	{
+		for( unsigned int i = 0; i < wordNumber; ++i ) { d[i] = _data[i].load( std::memory_order_relaxed ); }
+		return ( _key.load( std::memory_order_relaxed ) ^ fold( d ) ) == key;
+	}
+
+	void save(const uint64_t key, const data& d)
+	{
+		_key.store( key ^ fold( d ), std::memory_order_relaxed );
+		for( unsigned int i = 0; i < wordNumber; ++i ) { _data[i].store( d[i], std::memory_order_relaxed ); }
+	}
+
+	void clear()
+	{
+		// an all zero entry would match the key 0
+		save( ~0ull, data{} );
+	}
+
+private:
+	std::atomic<uint64_t> _key;
+	std::atomic<uint64_t> _data[wordNumber];
 };
 
 class pawnTable
 {
 public:
+	explicit pawnTable(const unsigned int mbSize = 1){ setSize( mbSize ); }
+
+	/*! \brief create the pawn table of a position, following the PawnHash and SharedPawnHash options
+	*/
+	static std::shared_ptr<pawnTable> create();
+
+	/*! \brief resize the table to the biggest power of 2 number of entries fitting in mbSize megabytes with their king shelter entries, the table is cleared
+	*/
+	void setSize(const unsigned int mbSize);
+	unsigned int getSize() const { return _mbSize; }
+	unsigned long int getEntries() const { return _pawnTable.size(); }
+	void clear();
+	bool isShared() const { return _shared; }
+
+	/*! \brief king shelter and pawn storm score, the key is the pawn key updated with the king square
+		every entry is a single 64 bit word holding the upper 32 bits of the key and the score
+	*/
+	bool getShieldStorm(const HashKey& key, Score& s) const
+	{
+		const uint64_t e = _shieldStorm[ key.getKey() & _shieldStormMask ].load( std::memory_order_relaxed );
+		if( ( e ^ key.getKey() ) & 0xFFFFFFFF00000000ull )
+		{
+			return false;
+		}
+		s = Score( int32_t( uint32_t( e ) ) );
+		return true;
+	}
+
+	void insertShieldStorm(const HashKey& key, const Score s)
+	{
+		_shieldStorm[ key.getKey() & _shieldStormMask ].store( ( key.getKey() & 0xFFFFFFFF00000000ull ) | uint32_t( s ), std::memory_order_relaxed );
+	}
+
 	void insert(
 		const HashKey& key,
 		const simdScore res,
@@ -52,22 +131,18 @@ public:
 		const bitMap* const weakSquares,
 		const bitMap* const holes) {
 
-		pawnEntry& x = _probe(key);
-
-		x.key = key;
-		x.res[0] = res[0];
-		x.res[1] = res[1];
-
-		x.weakPawns = weakPawns;
-		x.passedPawns = passedPawns;
+		pawnEntry::data d;
+		d[pawnEntry::weakPawns] = weakPawns;
+		d[pawnEntry::passedPawns] = passedPawns;
+		d[pawnEntry::whitePawnAttacks] = attackedSquares[whitePawns];
+		d[pawnEntry::blackPawnAttacks] = attackedSquares[blackPawns];
+		d[pawnEntry::whiteWeakSquares] = weakSquares[white];
+		d[pawnEntry::blackWeakSquares] = weakSquares[black];
+		d[pawnEntry::whiteHoles] = holes[white];
+		d[pawnEntry::blackHoles] = holes[black];
+		d[pawnEntry::score] = uint64_t( uint32_t( res[0] ) ) | ( uint64_t( uint32_t( res[1] ) ) << 32 );
 
-		x.pawnAttacks[0] = attackedSquares[whitePawns];
-		x.pawnAttacks[1] = attackedSquares[blackPawns];
-		
-		x.weakSquares[0] = weakSquares[white];
-		x.weakSquares[1] = weakSquares[black];
-		x.holes[0] = holes[white];
-		x.holes[1] = holes[black];
+		_probe(key).save( key.getKey(), d );
 	}
 	
 	bool getValues(
@@ -79,29 +154,34 @@ public:
 		bitMap * const weakSquares,
 		bitMap * const holes) const {
 	
-	const pawnEntry& probePawn = _probe(pawnKey);
-	
-	if (probePawn.key == pawnKey) {
-		weakPawns = probePawn.weakPawns;
-		passedPawns = probePawn.passedPawns;
-		attackedSquares[whitePawns] = probePawn.pawnAttacks[0];
-		attackedSquares[blackPawns] = probePawn.pawnAttacks[1];
-		weakSquares[white] = probePawn.weakSquares[0];
-		weakSquares[black] = probePawn.weakSquares[1];
-		holes[white] = probePawn.holes[0];
-		holes[black] = probePawn.holes[1];
-		res = simdScore{probePawn.res[0], probePawn.res[1], 0, 0};
+		ttStatistics::count( ttStatistics::pawnProbes );
+		pawnEntry::data d;
+		if( !_probe(pawnKey).load( pawnKey.getKey(), d ) ) {
+			return false;
+		}
+		ttStatistics::count( ttStatistics::pawnHits );
+
+		weakPawns = d[pawnEntry::weakPawns];
+		passedPawns = d[pawnEntry::passedPawns];
+		attackedSquares[whitePawns] = d[pawnEntry::whitePawnAttacks];
+		attackedSquares[blackPawns] = d[pawnEntry::blackPawnAttacks];
+		weakSquares[white] = d[pawnEntry::whiteWeakSquares];
+		weakSquares[black] = d[pawnEntry::blackWeakSquares];
+		holes[white] = d[pawnEntry::whiteHoles];
+		holes[black] = d[pawnEntry::blackHoles];
+		res = simdScore{ Score( uint32_t( d[pawnEntry::score] ) ), Score( uint32_t( d[pawnEntry::score] >> 32 ) ), 0, 0 };
 		return true;
-	} else {
-		return false;
 	}
-}
 private:
-	static const int _size = 8192;
-	unsigned int _getIndex( const HashKey& key ) const { return ( (unsigned int)key.getKey() ) % _size; }
-	const pawnEntry& _probe(const HashKey& key) const { return _pawnTable[_getIndex(key)]; }
-	pawnEntry& _probe(const HashKey& key) { return _pawnTable[_getIndex(key)]; }
-	std::array<pawnEntry,_size> _pawnTable;
+	unsigned int _mbSize = 0;
+	uint64_t _mask = 0;
+	bool _shared = false;
+	std::vector<pawnEntry> _pawnTable;
+	std::unique_ptr<std::atomic<uint64_t>[]> _shieldStorm;	// 4 entries for every pawn entry, 2 king squares per side
+	uint64_t _shieldStormMask = 0;
+
+	const pawnEntry& _probe(const HashKey& key) const { return _pawnTable[ key.getKey() & _mask ]; }
+	pawnEntry& _probe(const HashKey& key) { return _pawnTable[ key.getKey() & _mask ]; }
 };
 
 #endif /* TABLES_H_ */
@@ -26,6 +26,7 @@
 
 
 bool Perft::perftUseHash = false;
+unsigned int Perft::perftHashSize = 16;
 
 /*! \brief calculate the perft result
 	\author Marco Belli
@@ -41,7 +42,7 @@ unsigned long long Perft::perft(unsigned int depth)
 		return 1;
 	}
 #endif
-	PerftTranspositionTable tt;
+	auto& tt = PerftTranspositionTable::getInstance();
 	
 	unsigned long long tot;
 	if( perftUseHash && tt.retrieve(_pos.getKey(), depth, tot) )
@@ -24,6 +24,7 @@ class Perft
 {
 public:
 	static bool perftUseHash;
+	static unsigned int perftHashSize;
 	
 	explicit Perft( Position & pos ): _pos(pos){}
 	unsigned long long perft(unsigned int depth);
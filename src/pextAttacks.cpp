@@ -0,0 +1,54 @@
+/*
+	This file is part of Vajolet.
+
+    Vajolet is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    Vajolet is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with Vajolet.  If not, see <http://www.gnu.org/licenses/>
+*/
+
+#include "data.h"
+#include "koggeStone.h"
+#include "magicmoves.h"
+#include "pextAttacks.h"
+
+PextAttacks::entry PextAttacks::_rook[squareNumber];
+PextAttacks::entry PextAttacks::_bishop[squareNumber];
+alignas(64) bitMap PextAttacks::_table[tableSize];
+
+void PextAttacks::init()
+{
+	bitMap * next = _table;
+	auto fill = [&next]( entry& e, const bitMap mask, const tSquare sq, bitMap (*attacks)( const bitMap, const bitMap ) )
+	{
+		e.mask = mask;
+		e.attacks = next;
+		// walk all the subsets of the mask
+		bitMap occupancy = 0;
+		do
+		{
+			next[ _pext( occupancy, mask ) ] = attacks( bitSet( sq ), occupancy );
+			occupancy = ( occupancy - mask ) & mask;
+		}
+		while( occupancy );
+		next += bitMap( 1 ) << bitCnt( mask );
+	};
+
+	for( tSquare sq = A1; sq < squareNumber; ++sq )
+	{
+		fill( _rook[sq], magicmoves_r_mask[sq], sq, KoggeStone::rookAttacks );
+	}
+	for( tSquare sq = A1; sq < squareNumber; ++sq )
+	{
+		fill( _bishop[sq], magicmoves_b_mask[sq], sq, KoggeStone::bishopAttacks );
+	}
+	assert( next == _table + tableSize );
+}
@@ -0,0 +1,90 @@
+/*
+	This file is part of Vajolet.
+
+    Vajolet is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    Vajolet is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with Vajolet.  If not, see <http://www.gnu.org/licenses/>
+*/
+
+#ifndef PEXTATTACKS_H_
+#define PEXTATTACKS_H_
+
+#include <cassert>
+
+#if defined(__BMI2__)
+#include <immintrin.h>
+#endif
+
+#include "bitops.h"
+#include "tSquare.h"
+
+/*! \brief slider attacks indexed with the pext instruction
+
+	the relevant occupancy bits of a square are packed with pext and used as index in the attack table of the square,
+	so every square uses exactly 2^bits entries. Rooks and bishops share a single table of 107648 entries, the same 841 KB
+	of the packed magic tables: pext saves the multiply, not memory. The mask and the table pointer of a square share the
+	same cache line.
+	Movegen uses it in the 64BMI2 build (USE_PEXT), the other builds can still fill and query it with a software pext.
+	The 64AVX2 build keeps the magics: pext is microcoded and slow on the AMD cpus before Zen 3.
+*/
+class PextAttacks
+{
+public:
+	/*! \brief fill the attack table, it can be called more than once */
+	static void init();
+
+	inline static bitMap rookAttacks(const tSquare from, const bitMap occupancy)
+	{
+		assert(from < squareNumber);
+		const entry& e = _rook[from];
+		return e.attacks[ _pext( occupancy, e.mask ) ];
+	}
+
+	inline static bitMap bishopAttacks(const tSquare from, const bitMap occupancy)
+	{
+		assert(from < squareNumber);
+		const entry& e = _bishop[from];
+		return e.attacks[ _pext( occupancy, e.mask ) ];
+	}
+
+	static constexpr unsigned int tableSize = 102400 + 5248;	/*!< rook entries + bishop entries*/
+
+private:
+	struct entry
+	{
+		bitMap mask;
+		const bitMap * attacks;
+	};
+
+	static entry _rook[squareNumber];
+	static entry _bishop[squareNumber];
+	static bitMap _table[tableSize];
+
+	inline static bitMap _pext(const bitMap b, bitMap mask)
+	{
+#if defined(__BMI2__)
+		return _pext_u64( b, mask );
+#else
+		bitMap res = 0;
+		for( bitMap bit = 1; mask; bit += bit, mask &= mask - 1 )
+		{
+			if( b & mask & ( ~mask + 1 ) )
+			{
+				res |= bit;
+			}
+		}
+		return res;
+#endif
+	}
+};
+
+#endif /* PEXTATTACKS_H_ */
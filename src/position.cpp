@@ -14,6 +14,7 @@
     You should have received a copy of the GNU General Public License
     along with Vajolet.  If not, see <http://www.gnu.org/licenses/>
 */
+#include <algorithm>
 #include <sstream>
 
 #include "command.h"
@@ -206,7 +207,7 @@ const Position& Position::setupFromFen(const std::string& fenStr)
 	ss >> token;
 
 	x.clearCastleRight();
-	for (auto& cr : _castleRightsMask) {cr = (eCastle)0;}
+	for (auto& cr : _castleRightsMask) {cr = 0;}
 	for (auto& cp : _castlePath) {cp = 0ull;}
 	for (auto& ckp : _castleKingPath) {ckp = 0ull;}
 	for (auto& csq : _castleRookInvolved) {csq = squareNone;}
@@ -355,9 +356,9 @@ const Position& Position::setupFromFen(const std::string& fenStr)
 	x.setPawnKey( calcPawnKey() );
 	x.setMaterialKey( calcMaterialKey() );
 
-	calcCheckingSquares();
+	x.resetCheckInfo();
+	calcAttacks();
 
-	x.setHiddenCheckers( getHiddenCheckers<true>() );
 	x.setPinnedPieces( getHiddenCheckers<false>() );
 	x.setCheckers( getAttackersTo( getSquareOfOurKing() ) & _bitBoard[x.getPiecesOfOtherPlayer()] );
 
@@ -433,7 +434,11 @@ void Position::clear()
 		_bitBoard[i] = 0;
 	}
 	_stateInfo.clear();
-	_stateInfo.emplace_back(state());
+	_stateInfo.emplace();
+	if( !_nnueStack.empty() )
+	{
+		_nnueStack[0] = nnueAccumulator();
+	}
 
 }
 
@@ -794,8 +799,13 @@ void Position::doNullMove()
 
 	insertState(getActualState());
 	state &x = getActualState();
+	if( _nnueActive )
+	{
+		_prepareNnueAccumulator();
+	}
 
 	x.setCurrentMove( Move::NOMOVE );
+	x.setCheckers( 0 );
 	if( x.hasEpSquare() )
 	{
 		x.getKey().changeEp( x.getEpSquare() );
@@ -813,8 +823,7 @@ void Position::doNullMove()
 	std::swap(Us,Them);
 
 
-	calcCheckingSquares();
-	x.setHiddenCheckers( getHiddenCheckers<true>() );
+	x.resetCheckInfo();
 	x.setPinnedPieces( getHiddenCheckers<false>() );
 
 #ifdef	ENABLE_CHECK_CONSISTENCY
@@ -843,6 +852,10 @@ void Position::doMove(const Move & m)
 
 	insertState(getActualState());
 	state &x = getActualState();
+	if( _nnueActive )
+	{
+		_prepareNnueAccumulator();
+	}
 
 	x.setCurrentMove( m );
 
@@ -854,6 +867,9 @@ void Position::doMove(const Move & m)
 	bitboardIndex captured = ( m.isEnPassantMove() ? (x.isBlackTurn() ? whitePawns : blackPawns ) : getPieceAt(to) );
 	assert( isValidPiece( captured ) || captured == empty );
 
+	const bitMap oldOccupancy = getOccupationBitmap();
+	unsigned int dirtyPieces = 1u << piece;
+
 	// change side
 	x.getKey().changeSide();
 	++_ply;
@@ -875,16 +891,16 @@ void Position::doMove(const Move & m)
 		Color color = x.isBlackTurn() ? black : white;
 		eCastle cs = state::calcCastleRight(m.isKingSideCastle() ? castleOO: castleOOO, color);
 		
-		tSquare rFrom = _castleRookInvolved[cs];
+		tSquare rFrom = (tSquare)_castleRookInvolved[cs];
 		assert(rFrom<squareNumber);
 		bitboardIndex rook = getPieceAt(rFrom);
 		assert( isRook(rook) );
 		
-		tSquare rTo = _castleRookFinalSquare[cs];
+		tSquare rTo = (tSquare)_castleRookFinalSquare[cs];
 		assert(rTo<squareNumber);
 		
 		tSquare kFrom = from;
-		tSquare kTo  = _castleKingFinalSquare[cs];
+		tSquare kTo  = (tSquare)_castleKingFinalSquare[cs];
 		assert(kFrom<squareNumber);
 		assert(kTo<squareNumber);
 		
@@ -894,6 +910,11 @@ void Position::doMove(const Move & m)
 			movePiece( piece, kFrom, kTo );
 		}
 		putPiece(rook, rTo);
+		if( _nnueActive )
+		{
+			_addNnueDirtyPiece( rook, rFrom, rTo );
+			_addNnueDirtyPiece( piece, kFrom, kTo );
+		}
 		
 		x.getKey().updatePiece( rFrom, rook );
 		x.getKey().updatePiece( rTo, rook );
@@ -903,6 +924,8 @@ void Position::doMove(const Move & m)
 		x.addMaterial( _pstValue[rook][rTo] - _pstValue[rook][rFrom] );
 		x.addMaterial( _pstValue[piece][kTo] - _pstValue[piece][kFrom] );
 
+		dirtyPieces |= 1u << rook;
+
 	}
 	else 
 	{
@@ -922,6 +945,10 @@ void Position::doMove(const Move & m)
 
 			// remove piece
 			removePiece(captured,captureSquare);
+			if( _nnueActive )
+			{
+				_addNnueDirtyPiece( captured, captureSquare, squareNone );
+			}
 			// update material
 			x.removeMaterial( _pstValue[captured][captureSquare] );
 			x.removeNonPawnMaterial( _nonPawnValue[captured] );
@@ -933,12 +960,18 @@ void Position::doMove(const Move & m)
 
 			// reset fifty move counter
 			x.resetIrreversibleMoveCount();
+
+			dirtyPieces |= 1u << captured;
 		}
 
 		// update hashKey
 		x.getKey().updatePiece( from, piece );
 		x.getKey().updatePiece( to, piece );
 		movePiece(piece, from, to);
+		if( _nnueActive )
+		{
+			_addNnueDirtyPiece( piece, from, to );
+		}
 
 		x.addMaterial( _pstValue[piece][to] - _pstValue[piece][from] );
 	}
@@ -946,7 +979,7 @@ void Position::doMove(const Move & m)
 	// Update castle rights if needed
 	if ( x.hasCastleRights() && (_castleRightsMask[from] | _castleRightsMask[to]))
 	{
-		eCastle cr = _castleRightsMask[from] | _castleRightsMask[to];
+		eCastle cr = (eCastle)( _castleRightsMask[from] | _castleRightsMask[to] );
 		assert((x.getCastleRights() & cr)<16);
 		x.getKey().setCastlingRight( x.getCastleRights() & cr );
 		x.clearCastleRight( cr );
@@ -957,7 +990,7 @@ void Position::doMove(const Move & m)
 		// set en-passant
 		if(
 				abs(from-to)==16	// double push
-				&& (getAttackersTo((tSquare)((from+to)>>1))  & Them[Pawns])
+				&& isSquareSet( x.getAttacks( x.getPawnsOfOtherPlayer() ), (tSquare)((from+to)>>1) )	// still the attacks of the previous position, a double push doesn't change them
 		)
 		{
 			x.setEpSquare( (tSquare)((from+to)>>1) );
@@ -970,6 +1003,12 @@ void Position::doMove(const Move & m)
 
 			removePiece(piece,to);
 			putPiece(promotedPiece,to);
+			if( _nnueActive )
+			{
+				// the pawn has been recorded as moved to the promotion square
+				_nnueStack[ _stateInfo.size() - 1 ].dirty[ _nnueStack[ _stateInfo.size() - 1 ].dirtyCount - 1 ].to = squareNone;
+				_addNnueDirtyPiece( promotedPiece, squareNone, to );
+			}
 
 			x.addMaterial( _pstValue[promotedPiece][to] - _pstValue[piece][to] );
 			x.addNonPawnMaterial( _nonPawnValue[promotedPiece] );
@@ -980,12 +1019,16 @@ void Position::doMove(const Move & m)
 			x.getPawnKey().updatePiece( to,piece );
 			x.getMaterialKey().updatePiece( (tSquare)promotedPiece, (bitboardIndex)( getPieceCount(promotedPiece) - 1 ) );
 			x.getMaterialKey().updatePiece( (tSquare)piece, (bitboardIndex)getPieceCount(piece) );
+
+			dirtyPieces |= 1u << promotedPiece;
 		}
 		x.getPawnKey().updatePiece( from, piece );
 		x.getPawnKey().updatePiece( to, piece );
 		x.resetIrreversibleMoveCount();
 	}
 
+	updateAttacks( oldOccupancy ^ getOccupationBitmap(), dirtyPieces );
+
 	x.setCapturedPiece( captured );
 	x.changeNextTurn();
 
@@ -1003,11 +1046,14 @@ void Position::doMove(const Move & m)
 		}
 		else
 		{
-			if( isSquareSet( x.getCheckingSquares( piece ), to ) ) // should be old state, but checkingSquares has not been changed so far
+			// checking squares and hidden checkers aren't copied in the new state, they are read from the parent one
+			// where moveGivesCheck has calculated them
+			const state& parent = getState( getStateSize() - 2 );
+			if( isSquareSet( parent.getCheckingSquares( piece ), to ) )
 			{
 				x.addCheckers( bitSet(to) );
 			}
-			if( x.thereAreHiddenCheckers() && (x.isHiddenChecker( from ) ) )	// should be old state, but hiddenCheckersCandidate has not been changed so far
+			if( parent.thereAreHiddenCheckers() && (parent.isHiddenChecker( from ) ) )
 			{
 				if(!isRook(piece))
 				{
@@ -1021,8 +1067,7 @@ void Position::doMove(const Move & m)
 		}
 	}
 
-	calcCheckingSquares();
-	x.setHiddenCheckers( getHiddenCheckers<true>() );
+	x.resetCheckInfo();
 	x.setPinnedPieces( getHiddenCheckers<false>() );
 
 #ifdef	ENABLE_CHECK_CONSISTENCY
@@ -1055,11 +1100,11 @@ void Position::undoMove()
 		Color color = x.isBlackTurn() ? white : black;
 		eCastle cs = state::calcCastleRight(m.isKingSideCastle() ? castleOO: castleOOO, color);
 
-		tSquare rFrom = _castleRookInvolved[cs];
-		tSquare rTo = _castleRookFinalSquare[cs];
+		tSquare rFrom = (tSquare)_castleRookInvolved[cs];
+		tSquare rTo = (tSquare)_castleRookFinalSquare[cs];
 		
 		tSquare kFrom = from;
-		tSquare kTo = _castleKingFinalSquare[cs];
+		tSquare kTo = (tSquare)_castleKingFinalSquare[cs];
 		
 		assert(rFrom < squareNumber);
 		assert(rTo < squareNumber);
@@ -1129,13 +1174,13 @@ void Position::undoNullMove()
 void Position::setupCastleData (const eCastle cr, const tSquare kFrom, const tSquare kTo, const tSquare rFrom, const tSquare rTo) {
 	getActualState().setCastleRight( cr );
 
-	_castleRightsMask[kFrom] = _castleRightsMask[kFrom] | cr;
-	_castleRightsMask[rFrom] = cr;
+	_castleRightsMask[kFrom] |= (uint8_t)cr;
+	_castleRightsMask[rFrom] = (uint8_t)cr;
 	_castlePath.at (cr) = initCastlePath(kFrom, kTo, rFrom, rTo);
 	_castleKingPath.at (cr) = initKingPath(kFrom, kTo);
-	_castleRookInvolved.at (cr) = rFrom;
-	_castleKingFinalSquare.at (cr) = kTo;
-	_castleRookFinalSquare.at (cr) = rTo;
+	_castleRookInvolved.at (cr) = (uint8_t)rFrom;
+	_castleKingFinalSquare.at (cr) = (uint8_t)kTo;
+	_castleRookFinalSquare.at (cr) = (uint8_t)rTo;
 }
 
 bitMap Position::initCastlePath(const tSquare kSqFrom, const tSquare kSqTo, const tSquare rSqFrom, const tSquare rSqTo)
@@ -1290,42 +1335,159 @@ void Position::checkPosConsistency(int nn) const
 		sync_cout<<score[3]<<":"<<x.getNonPawnValue()[3]<<sync_endl;
 		block( "non pawn material error", nn );
 	}
+
+	bitMap all[2] = { 0, 0 };
+	for( bitboardIndex p = whiteKing; p <= blackPawns; p = bitboardIndex( p + 1 ) )
+	{
+		if( isValidPiece( p ) )
+		{
+			const bitMap att = calcAttacksOf(p);
+			all[ isBlackPiece(p) ] |= att;
+			if( att != x.getAttacks(p) )
+			{
+				display();
+				sync_cout<<"piece "<<p<<sync_endl;
+				block( "attack map error", nn );
+			}
+		}
+	}
+	if( all[white] != x.getAttacks(whitePieces) || all[black] != x.getAttacks(blackPieces) )
+	{
+		display();
+		block( "attack map union error", nn );
+	}
 }
 #endif
 
-/*! \brief calculate the checking squares given the king position
+/*! \brief calculate the check info of the actual state: the checking squares given the king position and the hidden checkers
 	\author Marco Belli
 	\version 1.0
 	\date 08/11/2013
 */
-inline void Position::calcCheckingSquares(void)
+void Position::calcCheckInfo(void) const
 {
-	state &s = getActualState();
-	const eNextMove& attackingPieces = s.getNextTurn();
-	tSquare kingSquare = getSquareOfTheirKing();
+	const state &s = getActualState();
+	const eNextMove attackingPieces = s.getNextTurn();
+	const tSquare kingSquare = getSquareOfTheirKing();
 
 	const bitMap occupancy = getOccupationBitmap();
-
-	s.resetCheckingSquares( getPieceOfPlayer(King, attackingPieces) );
 	assert(kingSquare<squareNumber);
 	assert( isValidPiece( getPieceOfPlayer( whitePawns, attackingPieces ) ) );
-	s.setCheckingSquares( getPieceOfPlayer( Rooks, attackingPieces ), Movegen::attackFrom<whiteRooks>(kingSquare,occupancy) );
-	s.setCheckingSquares( getPieceOfPlayer( Bishops, attackingPieces ), Movegen::attackFrom<whiteBishops>(kingSquare,occupancy) );
-	s.setCheckingSquares( getPieceOfPlayer( Queens, attackingPieces ), 
-		s.getCheckingSquares( getPieceOfPlayer( Rooks, attackingPieces) ) 
-		| s.getCheckingSquares( getPieceOfPlayer( Bishops, attackingPieces) ) );
-	s.setCheckingSquares( getPieceOfPlayer( Knights, attackingPieces ), Movegen::attackFrom<whiteKnights>(kingSquare) );
 
+	const bitMap rookSquares = Movegen::attackFrom<whiteRooks>(kingSquare,occupancy);
+	const bitMap bishopSquares = Movegen::attackFrom<whiteBishops>(kingSquare,occupancy);
+	s.setCheckingSquares( getPieceOfPlayer( King, attackingPieces ), 0 );
+	s.setCheckingSquares( getPieceOfPlayer( Rooks, attackingPieces ), rookSquares );
+	s.setCheckingSquares( getPieceOfPlayer( Bishops, attackingPieces ), bishopSquares );
+	s.setCheckingSquares( getPieceOfPlayer( Queens, attackingPieces ), rookSquares | bishopSquares );
+	s.setCheckingSquares( getPieceOfPlayer( Knights, attackingPieces ), Movegen::attackFrom<whiteKnights>(kingSquare) );
 	s.setCheckingSquares( getPieceOfPlayer( Pawns, attackingPieces ), attackingPieces? Movegen::attackFrom<whitePawns>(kingSquare) : Movegen::attackFrom<blackPawns>(kingSquare) );
 
-	assert( getPieceOfOpponent( Pawns, attackingPieces ) >=0 );
-	s.resetCheckingSquares( getPieceOfOpponent( King,    attackingPieces ) );
-	s.resetCheckingSquares( getPieceOfOpponent( Rooks,   attackingPieces ) );
-	s.resetCheckingSquares( getPieceOfOpponent( Bishops, attackingPieces ) );
-	s.resetCheckingSquares( getPieceOfOpponent( Queens,  attackingPieces ) );
-	s.resetCheckingSquares( getPieceOfOpponent( Knights, attackingPieces ) );
-	s.resetCheckingSquares( getPieceOfOpponent( Pawns,   attackingPieces ) );
+	s.setHiddenCheckers( getHiddenCheckers<true>() );
+	s.setCheckInfo();
+}
+
+/*! \brief get the actual state with its check info calculated
+*/
+inline const state& Position::getCheckInfo() const
+{
+	const state &s = getActualState();
+	if( !s.hasCheckInfo() )
+	{
+		calcCheckInfo();
+	}
+	return s;
+}
+
+/*! \brief calc the squares attacked by all the pieces of a given type
+*/
+bitMap Position::calcAttacksOf(const bitboardIndex piece) const
+{
+	assert( isValidPiece( piece ) );
+	const bitMap occupancy = getOccupationBitmap();
+	bitMap b = _bitBoard[piece];
+	bitMap res = 0;
+
+	switch( piece )
+	{
+	case whitePawns:
+		return ( ( b & ~fileMask(H1) ) << 9 ) | ( ( b & ~fileMask(A1) ) << 7 );
+	case blackPawns:
+		return ( ( b & ~fileMask(H1) ) >> 7 ) | ( ( b & ~fileMask(A1) ) >> 9 );
+	case whiteKing:
+	case blackKing:
+		return b ? Movegen::attackFrom<whiteKing>( firstOne(b) ) : 0;
+	case whiteKnights:
+	case blackKnights:
+		while(b)
+		{
+			res |= Movegen::attackFrom<whiteKnights>( iterateBit(b) );
+		}
+		return res;
+	case whiteBishops:
+	case blackBishops:
+		while(b)
+		{
+			res |= Movegen::attackFrom<whiteBishops>( iterateBit(b), occupancy );
+		}
+		return res;
+	case whiteRooks:
+	case blackRooks:
+		while(b)
+		{
+			res |= Movegen::attackFrom<whiteRooks>( iterateBit(b), occupancy );
+		}
+		return res;
+	default:
+		while(b)
+		{
+			res |= Movegen::attackFrom<whiteQueens>( iterateBit(b), occupancy );
+		}
+		return res;
+	}
+}
+
+/*! \brief calc from scratch the attack maps of the actual state
+*/
+void Position::calcAttacks(void)
+{
+	updateAttacks( 0, ( 0x7Eu << separationBitmap ) | 0x7Eu );
+}
+
+/*! \brief update the attack maps of the actual state after the board has been changed
+	\param changedSquares squares whose occupancy has been changed by the move
+	\param dirtyPieces mask ( 1 << piece ) of the piece types that have been moved, captured or promoted
+*/
+void Position::updateAttacks(bitMap changedSquares, unsigned int dirtyPieces)
+{
+	state &x = getActualState();
+
+	// the rays of a slider change only if they reached a square whose occupancy has changed
+	for( const bitboardIndex p: { whiteQueens, whiteRooks, whiteBishops, blackQueens, blackRooks, blackBishops } )
+	{
+		if( x.getAttacks(p) & changedSquares )
+		{
+			dirtyPieces |= 1u << p;
+		}
+	}
 
+	for( const bitboardIndex c: { whitePieces, blackPieces } )
+	{
+		const unsigned int mask = dirtyPieces & ( 0x7Eu << ( c - whitePieces ) );
+		if( mask )
+		{
+			bitMap all = 0;
+			for( bitboardIndex p = bitboardIndex( c - whitePieces + King ); p < c; p = bitboardIndex( p + 1 ) )
+			{
+				if( mask & ( 1u << p ) )
+				{
+					x.setAttacks( p, calcAttacksOf(p) );
+				}
+				all |= x.getAttacks(p);
+			}
+			x.setAttacks( c, all );
+		}
+	}
 }
 
 /*! \brief get the hidden checkers/pinners of a position
@@ -1392,7 +1554,7 @@ bool Position::moveGivesCheck(const Move& m)const
 	tSquare to = m.getTo();
 	bitboardIndex piece = getPieceAt(from);
 	assert( isValidPiece( piece ) );
-	const state &s = getActualState();
+	const state &s = getCheckInfo();
 
 	// Direct check ?
 	if( isSquareSet( s.getCheckingSquares( piece ), to ) )
@@ -1444,9 +1606,9 @@ bool Position::moveGivesCheck(const Move& m)const
 		eCastle cs = state::calcCastleRight(m.isKingSideCastle() ? castleOO: castleOOO, color);
 		
 		tSquare kFrom = from;
-		tSquare kTo = _castleKingFinalSquare[cs];
-		tSquare rFrom = _castleRookInvolved[cs];
-		tSquare rTo = _castleRookFinalSquare[cs];
+		tSquare kTo = (tSquare)_castleKingFinalSquare[cs];
+		tSquare rFrom = (tSquare)_castleRookInvolved[cs];
+		tSquare rTo = (tSquare)_castleRookFinalSquare[cs];
 		assert(rFrom<squareNumber);
 		assert(rTo<squareNumber);
 
@@ -1472,7 +1634,7 @@ bool Position::moveGivesDoubleCheck(const Move& m)const
 	tSquare from = m.getFrom();
 	tSquare to = m.getTo();
 	bitboardIndex piece = getPieceAt( from );
-	const state &s = getActualState();
+	const state &s = getCheckInfo();
 
 	// Direct check ?
 	return isSquareSet( s.getCheckingSquares( piece ), to) && ( s.thereAreHiddenCheckers() && s.isHiddenChecker( from ) );
@@ -1491,18 +1653,13 @@ bool Position::hasRepeated(bool isPVline) const
 	const state &s = getActualState();
 	unsigned int counter = 1;
 	const HashKey& actualkey = s.getKey();
-	auto it = _stateInfo.rbegin();
-	
+	const unsigned int last = _stateInfo.size() - 1;
 
-	int e = std::min( s.getIrreversibleMoveCount(), s.getPliesFromNullCount() );
-	if( e >= 4)
+	// a search copy doesn't have the states older than 100 plies, the 50 moves rule has already ended the game there
+	const unsigned int e = std::min( { s.getIrreversibleMoveCount(), s.getPliesFromNullCount(), last } );
+	for(unsigned int i = 4 ; i<=e; i+=2 )
 	{
-		std::advance( it, 2 );
-	}
-	for(int i = 4 ;	i<=e; i+=2 )
-	{
-		std::advance( it, 2 );
-		if(it->getKey() == actualkey)
+		if(_stateInfo[last - i].getKey() == actualkey)
 		{
 			counter++;
 			if(!isPVline || counter>=3)
@@ -1660,7 +1817,7 @@ bool Position::isMoveLegal(const Move &m)const
 					return false;
 				}
 				
-				const tSquare rookSq = _castleRookInvolved[cs];
+				const tSquare rookSq = (tSquare)_castleRookInvolved[cs];
 
 				// malformed move
 				if ( rookSq != m.getTo() )
@@ -1684,7 +1841,11 @@ bool Position::isMoveLegal(const Move &m)const
 					return false;
 				}
 				//king moves should not leave king in check
-				if((getAttackersTo(m.getTo(),_bitBoard[occupiedSquares] & ~Us[King]) & Them[Pieces]))
+				if( isSquareSet( s.getAttacks( s.getPiecesOfOtherPlayer() ), m.getTo() ) )
+				{
+					return false;
+				}
+				if( s.isInCheck() && (getAttackersTo(m.getTo(),_bitBoard[occupiedSquares] & ~Us[King]) & Them[Pieces]))
 				{
 					return false;
 				}
@@ -1803,17 +1964,17 @@ bool Position::isMoveLegal(const Move &m)const
 
 Position::~Position() = default;
 
-Position::Position(const pawnHash usePawnHash):_ply(0), _mg(*this), _isChess960(false)
+Position::Position(const pawnHash usePawnHash):_ply(0), _isChess960(false), _mg(*this)
 {
 	
 	_stateInfo.clear();
-	_stateInfo.emplace_back(state());
+	_stateInfo.emplace();
 	_stateInfo[0].setNextTurn( whiteTurn );
 
 	updateUsThem();
 	
 	// todo create value NOCASTLE = 0
-	for (auto& cr : _castleRightsMask) {cr = (eCastle)0;}
+	for (auto& cr : _castleRightsMask) {cr = 0;}
 	for (auto& cp : _castlePath) {cp = 0ull;}
 	for (auto& ckp : _castleKingPath) {ckp = 0ull;}
 	for (auto& sq : _castleRookInvolved) {sq = squareNone;}
@@ -1821,15 +1982,17 @@ Position::Position(const pawnHash usePawnHash):_ply(0), _mg(*this), _isChess960(
 	for (auto& sq : _castleRookFinalSquare) {sq = squareNone;}
 	
 	if (usePawnHash == pawnHash::on) {
-		_pawnHashTable = std::make_unique<pawnTable>();
+		_pawnHashTable = pawnTable::create();
+		_createMaterialTable();
 	}
 }
 
 
-Position::Position(const Position& other, const pawnHash usePawnHash): _ply(other._ply), _mg(*this), _stateInfo(other._stateInfo), _squares(other._squares), _bitBoard(other._bitBoard), _isChess960(other._isChess960)
+Position::Position(const Position& other, const pawnHash usePawnHash): _bitBoard(other._bitBoard), _squares(other._squares), _stateInfo(other._stateInfo), _ply(other._ply), _isChess960(other._isChess960), _mg(*this)
 {
 	
 	updateUsThem();
+	_nnueActive = other._nnueActive;
 	_castleRightsMask = other._castleRightsMask;
 	_castlePath = other._castlePath;
 	_castleKingPath = other._castleKingPath;
@@ -1838,10 +2001,88 @@ Position::Position(const Position& other, const pawnHash usePawnHash): _ply(othe
 	_castleRookFinalSquare = other._castleRookFinalSquare;
 	
 	if (usePawnHash == pawnHash::on) {
-		_pawnHashTable = std::make_unique<pawnTable>();
+		_pawnHashTable = pawnTable::create();
+		_createMaterialTable();
+	}
+}
+
+
+void Position::_createMaterialTable()
+{
+	_materialTable = std::make_unique<std::array<materialEntry, _materialTableSize>>();
+	for( auto& e: *_materialTable )
+	{
+		// an empty entry shall not match any material key
+		e.key = ~tKey(0);
+	}
+}
+
+void Position::updateNnue()
+{
+	_nnueActive = uciParameters::useNnue && nnue::getInstance().isLoaded();
+	// the network may have changed, every accumulator has to be calculated again
+	_nnueStack.clear();
+}
+
+inline void Position::_prepareNnueAccumulator()
+{
+	const size_t idx = _stateInfo.size() - 1;
+	if( _nnueStack.size() <= idx )
+	{
+		_nnueStack.resize( idx + 1 );
+	}
+	_nnueStack[idx].computed = false;
+	_nnueStack[idx].dirtyCount = 0;
+}
+
+inline void Position::_addNnueDirtyPiece(const bitboardIndex piece, const tSquare from, const tSquare to)
+{
+	nnueAccumulator& acc = _nnueStack[ _stateInfo.size() - 1 ];
+	assert( acc.dirtyCount < nnueAccumulator::maxDirtyPieces );
+	acc.dirty[ acc.dirtyCount++ ] = { piece, from, to };
+}
+
+/*! \brief evaluate the position with the network, updating the accumulators from the nearest calculated one
+*/
+Score Position::_evalNnue() const
+{
+	const nnue& net = nnue::getInstance();
+	const size_t idx = _stateInfo.size() - 1;
+	if( _nnueStack.size() <= idx )
+	{
+		_nnueStack.resize( idx + 1 );
+	}
+
+	nnueAccumulator& acc = _nnueStack[idx];
+	if( !acc.computed )
+	{
+		size_t first = idx;
+		while( first > 0 && !_nnueStack[first].computed && _nnueStack[first].dirtyCount != nnueAccumulator::needRefresh )
+		{
+			--first;
+		}
+		if( _nnueStack[first].computed )
+		{
+			for( size_t i = first + 1; i <= idx; ++i )
+			{
+				net.update( _nnueStack[i - 1], _nnueStack[i] );
+			}
+		}
+		else
+		{
+			net.refresh( *this, acc );
+		}
 	}
+	return net.evaluate( acc, isBlackTurn() ? black : white );
 }
 
+void Position::updatePawnHashTable()
+{
+	if( _pawnHashTable && ( _pawnHashTable->isShared() != uciParameters::sharedPawnHash || _pawnHashTable->getSize() != uciParameters::pawnHashSize ) )
+	{
+		_pawnHashTable = pawnTable::create();
+	}
+}
 
 Position& Position::operator=(const Position& other)
 {
@@ -1850,9 +2091,34 @@ Position& Position::operator=(const Position& other)
 		return *this;
 	}
 
+	_stateInfo = other._stateInfo;
+	_copyBoard(other);
+
+	return *this;
+}
+
+/*! \brief copy a position for a search, the states older than the last irreversible move or null move can't be repeated
+	and the ones older than 100 plies are beyond the 50 moves rule, so at most 101 states are copied whatever the length of the game
+*/
+void Position::cloneForSearch(const Position& other)
+{
+	if (this == &other)
+	{
+		return;
+	}
+
+	const state& s = other.getActualState();
+	const unsigned int plies = std::min( { s.getIrreversibleMoveCount(), s.getPliesFromNullCount(), 100u } ) + 1;
+	_stateInfo.assignLast( other._stateInfo, std::min( plies, other.getStateSize() ) );
+	_copyBoard(other);
+}
+
+void Position::_copyBoard(const Position& other)
+{
 	_ply = other._ply;
+	_nnueActive = other._nnueActive;
+	_nnueStack.clear();
 
-	_stateInfo = other._stateInfo;
 	_squares = other._squares;
 	_bitBoard = other._bitBoard;
 	_isChess960 = other._isChess960;
@@ -1865,8 +2131,6 @@ Position& Position::operator=(const Position& other)
 	_castleRookInvolved = other._castleRookInvolved;
 	_castleKingFinalSquare = other._castleKingFinalSquare;
 	_castleRookFinalSquare = other._castleRookFinalSquare;
-
-	return *this;
 }
 
 inline void Position::updateUsThem()
@@ -1890,7 +2154,7 @@ inline void Position::putPiece(const bitboardIndex piece,const tSquare s)
 
 	assert( _squares[s] == empty );
 
-	_squares[s] = piece;
+	_squares[s] = (uint8_t)piece;
 	_bitBoard[piece] |= b;
 	_bitBoard[occupiedSquares] |= b;
 	_bitBoard[color] |= b;
@@ -1916,7 +2180,7 @@ inline void Position::movePiece(const bitboardIndex piece,const tSquare from,con
 	_bitBoard[piece] ^= fromTo;
 	_bitBoard[color] ^= fromTo;
 	_squares[from] = empty;
-	_squares[to] = piece;
+	_squares[to] = (uint8_t)piece;
 
 
 }
@@ -1971,7 +2235,7 @@ std::string Position::_printEpSquare( const state& st)
 */
 inline void Position::insertState( state & s )
 {
-	_stateInfo.emplace_back(s);
+	_stateInfo.pushIncremental(s);
 }
 
 /*! \brief  remove the last state
@@ -1982,7 +2246,7 @@ inline void Position::insertState( state & s )
 */
 inline void  Position::removeState()
 {
-	_stateInfo.pop_back();
+	_stateInfo.pop();
 }
 
 unsigned int Position::getNumberOfLegalMoves() const
@@ -2013,5 +2277,5 @@ bitMap Position::getCastleKingPath(const eCastle c ) const
 tSquare Position::getCastleRookInvolved(const eCastle c ) const
 {
 	assert( c < 9);
-	return _castleRookInvolved[c];
+	return (tSquare)_castleRookInvolved[c];
 }
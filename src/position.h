@@ -30,8 +30,10 @@
 #include "hashKey.h"
 #include "movegen.h"
 #include "move.h"
+#include "nnue.h"
 #include "score.h"
 #include "state.h"
+#include "stateStack.h"
 #include "vajolet.h"
 //---------------------------------------------------
 // forward declarations
@@ -73,6 +75,16 @@ public:
 	explicit Position(const Position& other, const pawnHash usePawnHash = pawnHash::on);
 	~Position();
 	Position& operator=(const Position& other);
+	/*! \brief copy other keeping only the states needed to detect repetitions, used to start the helper search threads
+	*/
+	void cloneForSearch(const Position& other);
+	/*! \brief follow a change of the PawnHash and SharedPawnHash options, to be called when no search is running
+	*/
+	void updatePawnHashTable();
+	/*! \brief follow a change of the UseNNUE option or of the loaded network, to be called when no search is running
+	*/
+	void updateNnue();
+	bool isNnueActive() const { return _nnueActive; }
 	
 	
 	void setupCastleData (const eCastle cr, const tSquare kFrom, const tSquare kTo, const tSquare rFrom, const tSquare rTo);
@@ -95,12 +107,12 @@ public:
 
 	inline bitboardIndex getPieceAt(const tSquare sq) const
 	{
-		return _squares[sq];
+		return (bitboardIndex)_squares[sq];
 	}
 
 	inline bitboardIndex getPieceTypeAt(const tSquare sq) const
 	{
-		return getPieceType(_squares[sq]);
+		return getPieceType( getPieceAt(sq) );
 	}
 
 	inline tSquare getSquareOfThePiece(const bitboardIndex piece) const
@@ -146,6 +158,7 @@ public:
 
 
 	template<bool trace>Score eval(void) const;
+	Score eval(const Score alpha, const Score beta, bool& exact) const;
 	bool isDraw(bool isPVline) const;
 	bool hasRepeated(bool isPVline = false) const;
 
@@ -161,6 +174,31 @@ public:
 		return getActualState().getKey();
 	}
 
+	/*! \brief cheap estimate of the key of the position reached after the move
+		castling, promotions, en passant and castle rights changes are not taken into account, it's meant to be used only to prefetch hash tables
+	*/
+	const HashKey keyAfter(const Move& m) const
+	{
+		HashKey k = getKey();
+		const tSquare from = m.getFrom();
+		const tSquare to = m.getTo();
+		const bitboardIndex piece = getPieceAt( from );
+		const bitboardIndex captured = getPieceAt( to );
+
+		k.changeSide();
+		if( getActualState().hasEpSquare() )
+		{
+			k.changeEp( getActualState().getEpSquare() );
+		}
+		if( captured != empty )
+		{
+			k.updatePiece( to, captured );
+		}
+		k.updatePiece( from, piece );
+		k.updatePiece( to, piece );
+		return k;
+	}
+
 	const HashKey getExclusionKey(void) const
 	{
 		return getActualState().getKey().getExclusionKey();
@@ -345,11 +383,6 @@ public:
 	//--------------------------------------------------------
 	static simdScore pieceValue[lastBitboard];
 private:
-
-
-	Position& operator=(Position&& ) noexcept = delete;
-	Position(Position&& ) noexcept = delete;
-
 	//--------------------------------------------------------
 	// private struct
 	//--------------------------------------------------------
@@ -368,7 +401,34 @@ private:
 		Score val;
 
 	};
-	
+public:
+	/*! \brief all the material dependent evaluation data of a material signature, filling a cache line
+	*/
+	struct alignas(64) materialEntry
+	{
+		simdScore imbalance;			// material imbalance score
+		tKey key;
+		bool (Position::*pointer)(Score &) const;	// endgame function
+		Score val;						// endgame value or saturation
+		unsigned int gamePhase;
+		materialStruct::tType type;		// endgame type, valid if hasEndgame
+		bool hasEndgame;				// a specialized evaluation exists for the material signature
+		bool loneKing;					// one side has only the king, evaluated by evalKxvsK
+	};
+
+	/*! \brief material data of the position, read from the material table of the position if it has one
+	*/
+	const materialEntry& getMaterialData() const;
+	/*! \brief calculate the material data of the position, without caching it
+	*/
+	void calcMaterialData( materialEntry& e ) const;
+
+private:
+
+
+	Position& operator=(Position&& ) noexcept = delete;
+	Position(Position&& ) noexcept = delete;
+
 	//--------------------------------------------------------
 	// private static members
 	//--------------------------------------------------------	
@@ -387,32 +447,37 @@ private:
 	//--------------------------------------------------------
 	// private members
 	//--------------------------------------------------------	
-	std::array<eCastle, squareNumber> _castleRightsMask;
-	
-	std::array<bitMap ,9> _castlePath;				// path that need to be free to be able to castle
-	std::array<bitMap, 9> _castleKingPath;			// path to be traversed by the king when castling
-	std::array<tSquare ,9> _castleRookInvolved;		// rook involved in the castling
-	std::array<tSquare ,9> _castleKingFinalSquare;	// king destination square of castling
-	std::array<tSquare ,9> _castleRookFinalSquare;	// rook destination square of castling
-	
-	unsigned int _ply;
-	const Movegen _mg;
-
-
-	/*used for search*/
-	mutable std::unique_ptr<pawnTable> _pawnHashTable;
-
-	std::vector<state> _stateInfo;
+	// members used by doMove and by the move generator first, the castle data and the tables after them
 
 	/*! \brief board rapresentation
 		\author Marco Belli
 		\version 1.0
 		\date 27/10/2013
 	*/
-	std::array<bitboardIndex,squareNumber> _squares;		// board square rapresentation to speed up, it contain pieces indexed by square
 	std::array<bitMap,lastBitboard> _bitBoard;			// bitboards indexed by bitboardIndex enum
+	std::array<uint8_t,squareNumber> _squares;		// board square rapresentation to speed up, it contain the bitboardIndex of the pieces indexed by square
 	bitMap *Us,*Them;	/*!< pointer to our & their pieces _bitBoard*/
+	stateStack _stateInfo;
+	unsigned int _ply;
 	bool _isChess960;
+	bool _nnueActive = false;
+	const Movegen _mg;
+
+	std::array<uint8_t, squareNumber> _castleRightsMask;	// castle rights lost moving from or to a square
+	std::array<uint8_t ,9> _castleRookInvolved;		// rook involved in the castling
+	std::array<uint8_t ,9> _castleKingFinalSquare;	// king destination square of castling
+	std::array<uint8_t ,9> _castleRookFinalSquare;	// rook destination square of castling
+	std::array<bitMap ,9> _castlePath;				// path that need to be free to be able to castle
+	std::array<bitMap, 9> _castleKingPath;			// path to be traversed by the king when castling
+
+
+	/*used for search*/
+	mutable std::shared_ptr<pawnTable> _pawnHashTable;
+	static constexpr unsigned int _materialTableSize = 1024;
+	mutable std::unique_ptr<std::array<materialEntry, _materialTableSize>> _materialTable;
+	mutable materialEntry _materialScratch;	// material data of positions without a material table
+	mutable std::vector<nnueAccumulator> _nnueStack;	// accumulators of the network, indexed as _stateInfo
+
 
 	//--------------------------------------------------------
 	// private methods
@@ -422,6 +487,14 @@ private:
 	inline void removeState();
 
 	void updateUsThem();
+	void _copyBoard(const Position& other);
+	void _createMaterialTable();
+	inline void _prepareNnueAccumulator();
+	inline void _addNnueDirtyPiece(const bitboardIndex piece, const tSquare from, const tSquare to);
+	Score _evalNnue() const;
+	template<bool trace, bool lazy> Score _eval(const Score alpha, const Score beta, bool& exact) const;
+	inline Score _finalizeScore(const simdScore& res, const signed int gamePhase, const Score mulCoeff, const Score lowSat, const Score highSat) const;
+	inline bool _isLazyCutoff(const simdScore& res, const signed int gamePhase, const Score mulCoeff, const Score lowSat, const Score highSat, const Score margin, const Score alpha, const Score beta, Score& estimate) const;
 
 
 	HashKey calcKey(void) const;
@@ -433,7 +506,11 @@ private:
 	void checkPosConsistency(int nn) const;
 #endif
 	void clear();
-	inline void calcCheckingSquares(void);
+	void calcCheckInfo(void) const;
+	inline const state& getCheckInfo() const;
+	bitMap calcAttacksOf(const bitboardIndex piece) const;
+	void calcAttacks(void);
+	void updateAttacks(bitMap changedSquares, unsigned int dirtyPieces);
 	template<bool our>
 	bitMap getHiddenCheckers() const;
 
@@ -447,11 +524,17 @@ private:
 	template<bitboardIndex piece> simdScore evalPieces(const bitMap * const weakSquares,  bitMap * const attackedSquares ,const bitMap * const holes, bitMap const blockedPawns, bitMap * const kingRing, unsigned int * const kingAttackersCount, unsigned int * const kingAttackersWeight, unsigned int * const kingAdjacentZoneAttacksCount, bitMap & weakPawns) const;
 
 	template<Color c> Score evalShieldStorm(tSquare ksq) const;
+	template<Color c> Score calcShieldStorm(tSquare ksq) const;
 	template<Color c> simdScore evalKingSafety(Score kingSafety, unsigned int kingAttackersCount, unsigned int kingAdjacentZoneAttacksCount, unsigned int kingAttackersWeight, bitMap * const attackedSquares) const;
 	
+	template<Color c> void calcPawnSpans(bitMap * const attackedSquares, bitMap * const weakSquares, bitMap * const holes) const;
+	template<Color c> bitMap calcKingRing() const;
+	template<Color c> bool hasBishopPair() const;
+	template<Color c> int calcSpace(const bitMap * const attackedSquares) const;
+	template<Color c> simdScore evalThreats(const bitMap * const attackedSquares) const;
+	template<Color c> Score evalKingShelter(const bitMap * const attackedSquares) const;
 	simdScore calcPawnValues(bitMap& weakPawns, bitMap& passedPawns, bitMap * const attackedSquares , bitMap * const weakSquares, bitMap * const holes) const;
 
-	const materialStruct* getMaterialData() const;
 	bool evalKxvsK(Score& res) const;
 	bool evalKBPsvsK(Score& res) const;
 	bool evalKQvsKP(Score& res) const;
@@ -471,5 +554,7 @@ private:
 
 };
 
+static_assert( sizeof(Position) <= 640, "Position has grown, check the layout of its members" );
+
 
 #endif /* POSITION_H_ */
@@ -46,7 +46,7 @@ void testSimmetry(const Position& pos)
 {
 	static Position ppp(Position::pawnHash::off);
 
-	ppp.setupFromFen(pos.getSymmetricFen(), pos.isChess960());
+	ppp.setupFromFen(pos.getSymmetricFen());
 
 	Score staticEval = pos.eval<false>();
 	Score test = ppp.eval<false>();
@@ -138,6 +138,7 @@ private:
 
 
 	SearchData _sd;
+	qsearchTable _qtt;
 	unsigned long long _visitedNodes = 0;
 	unsigned long long _tbHits = 0;
 	unsigned int _maxPlyReached = 0;
@@ -185,7 +186,10 @@ private:
 	void _showCurrenLine( const unsigned int ply, const int depth );
 	bool _MateDistancePruning( const unsigned int ply, Score& alpha, Score& beta) const;
 	void _appendTTmoveIfLegal(  const Move& ttm, PVline& pvLine ) const;
-	bool _canUseTTeValue( const bool PVnode, const Score beta, const Score ttValue, const ttEntry * const tte, short int depth ) const;
+	bool _canUseTTeValue( const bool PVnode, const Score beta, const Score ttValue, const ttEntry& tte, short int depth ) const;
+	void _storeQsearch( const HashKey& key, Score value, ttType type, short int depth, const Move& move, Score statValue );
+	Score _staticEval();
+	Score _staticEval(const Score alpha, const Score beta, bool& exact);
 	const HashKey _getSearchKey( const bool excludedMove = false ) const;
 
 	using tableBaseRes = struct{ ttType TTtype; Score value;};
@@ -318,6 +322,9 @@ unsigned long long Search::impl::getTbHits() const
 void Search::impl::cleanMemoryBeforeStartingNewSearch(void)
 {
 	_sd.cleanData();
+	_qtt.clear();
+	_pos.updatePawnHashTable();
+	_pos.updateNnue();
 	_visitedNodes = 0;
 	_tbHits = 0;
 	_multiPVmanager.clean();
@@ -624,6 +631,7 @@ SearchResult Search::impl::go(int depth, Score alpha, Score beta, PVline pvToBeF
 	
 	//clean transposition table
 	transpositionTable::getInstance().newSearch();
+	ttStatistics::reset();
 	
 	_pvLineFollower.setPVline(pvToBeFollowed);
 	
@@ -685,7 +693,7 @@ SearchResult Search::impl::go(int depth, Score alpha, Score beta, PVline pvToBeF
 
 		helperResults[i].firstMove = m;
 		helperSearch[i-1].resetStopCondition();
-		helperSearch[i-1]._pos = _pos;
+		helperSearch[i-1]._pos.cloneForSearch(_pos);
 		helperSearch[i-1]._pvLineFollower.setPVline(pvToBeFollowed);
 		helperSearch[i-1]._initialTurn = _initialTurn;
 		helperThread.emplace_back( std::thread(&Search::impl::idLoop, &helperSearch[i-1], std::ref(helperResults), i, std::ref(toBeExcludedMove), depth, alpha, beta, false));
@@ -768,20 +776,69 @@ void Search::impl::_appendTTmoveIfLegal( const Move& ttm, PVline& pvLine ) const
 	}
 }
 
-inline bool Search::impl::_canUseTTeValue( const bool PVnode, const Score beta, const Score ttValue, const ttEntry * const tte, short int depth ) const
+inline bool Search::impl::_canUseTTeValue( const bool PVnode, const Score beta, const Score ttValue, const ttEntry& tte, short int depth ) const
 {
 	return
-		( tte->getDepth() >= depth )
-		&& ( ttValue != SCORE_NONE )// Only in case of TT access race
+		( tte.getDepth() >= depth )
+		&& ( ttValue != SCORE_NONE )// void entry
 		&& (
 			PVnode ?
 				false :
 			ttValue >= beta ?
-				tte->isTypeGoodForBetaCutoff():
-				tte->isTypeGoodForAlphaCutoff()
+				tte.isTypeGoodForBetaCutoff():
+				tte.isTypeGoodForAlphaCutoff()
 		);
 }
 
+/*! \brief quiescence search results go to the thread local table, to avoid evicting the deeper entries of the main one
+*/
+inline void Search::impl::_storeQsearch( const HashKey& key, Score value, ttType type, short int depth, const Move& move, Score statValue )
+{
+	if( uciParameters::qsearchHash )
+	{
+		_qtt.store( key, value, type, depth, move.getPacked(), statValue );
+	}
+	else
+	{
+		transpositionTable::getInstance().store( key, value, type, depth, move, statValue );
+	}
+}
+
+/*! \brief static evaluation of the position, read from the evaluation cache shared by the threads when possible
+*/
+inline Score Search::impl::_staticEval()
+{
+	auto& ec = evalCache::getInstance();
+	const HashKey& key = _pos.getKey();
+	Score eval;
+	if( !ec.probe( key, eval ) )
+	{
+		eval = _pos.eval<false>();
+		ec.store( key, eval );
+	}
+	return eval;
+}
+
+/*! \brief lazy static evaluation, a value farther than a margin from the window may be an estimate and is not cached
+	\param exact set to false when the returned value is only an estimate
+*/
+inline Score Search::impl::_staticEval(const Score alpha, const Score beta, bool& exact)
+{
+	auto& ec = evalCache::getInstance();
+	const HashKey& key = _pos.getKey();
+	Score eval;
+	exact = true;
+	if( !ec.probe( key, eval ) )
+	{
+		eval = _pos.eval( alpha, beta, exact );
+		if( exact )
+		{
+			ec.store( key, eval );
+		}
+	}
+	return eval;
+}
+
 inline const HashKey Search::impl::_getSearchKey( const bool excludedMove ) const
 {
 	return excludedMove ? _pos.getExclusionKey() : _pos.getKey();
@@ -932,16 +989,24 @@ template<Search::impl::nodeType type, bool log> Score Search::impl::alphaBeta(un
 	//--------------------------------------
 	// test the transposition table
 	//--------------------------------------
-	ttEntry* tte = transpositionTable::getInstance().probe( posKey );
-	Move ttMove( tte->getPackedMove() );
-	Score ttValue = transpositionTable::scoreFromTT(tte->getValue(), ply);
+	ttEntry tte = transpositionTable::getInstance().probe( posKey );
+	Move ttMove( tte.getPackedMove() );
+	Score ttValue = transpositionTable::scoreFromTT(tte.getValue(), ply);
+	if constexpr ( ttStatistics::enabled )
+	{
+		if( ttMove && !_pos.isMoveLegal(ttMove) )
+		{
+			ttStatistics::count( ttStatistics::keyCollisions );
+		}
+	}
 
 	if (log) ln->test("CanUseTT");
 	if (	type != nodeType::ROOT_NODE
 			&& _canUseTTeValue( PVnode, beta, ttValue, tte, depth )
 		)
 	{
-		transpositionTable::getInstance().refresh(*tte);
+		ttStatistics::count( ttStatistics::cutoffs );
+		transpositionTable::getInstance().refresh(posKey);
 		
 		if constexpr (PVnode)
 		{
@@ -990,7 +1055,7 @@ template<Search::impl::nodeType type, bool log> Score Search::impl::alphaBeta(un
 					res.TTtype,
 					std::min( 100 * ONE_PLY , depth + 6 * ONE_PLY),
 					ttMove,
-					_pos.eval<false>());
+					_staticEval());
 				if (log) ln->logReturnValue(res.value);
 				if (log) ln->endSection();
 				return res.value;
@@ -1006,9 +1071,9 @@ template<Search::impl::nodeType type, bool log> Score Search::impl::alphaBeta(un
 
 	Score staticEval;
 	Score eval;
-	if(inCheck || tte->getType() == typeVoid)
+	if(inCheck || tte.getType() == typeVoid)
 	{
-		staticEval = _pos.eval<false>();
+		staticEval = _staticEval();
 		eval = staticEval;
 		if (log) ln->calcStaticEval(staticEval);
 
@@ -1018,7 +1083,12 @@ template<Search::impl::nodeType type, bool log> Score Search::impl::alphaBeta(un
 	}
 	else
 	{
-		staticEval = tte->getStaticValue();
+		staticEval = tte.getStaticValue();
+		// qsearch doesn't store the static value of a lazy evaluation
+		if( staticEval == SCORE_NONE )
+		{
+			staticEval = _staticEval();
+		}
 		eval = staticEval;
 		assert(staticEval < SCORE_INFINITE);
 		assert(staticEval > -SCORE_INFINITE);
@@ -1027,8 +1097,8 @@ template<Search::impl::nodeType type, bool log> Score Search::impl::alphaBeta(un
 		if (ttValue != SCORE_NONE)
 		{
 			if (
-					( tte->isTypeGoodForBetaCutoff() && (ttValue > eval) )
-					|| (tte->isTypeGoodForAlphaCutoff() && (ttValue < eval) )
+					( tte.isTypeGoodForBetaCutoff() && (ttValue > eval) )
+					|| (tte.isTypeGoodForAlphaCutoff() && (ttValue < eval) )
 				)
 			{
 				if (log) ln->refineEval(ttValue);
@@ -1204,6 +1274,7 @@ template<Search::impl::nodeType type, bool log> Score Search::impl::alphaBeta(un
 					
 					++pbCount;
 					
+					transpositionTable::getInstance().prefetch(_pos.keyAfter(m));
 					_pos.doMove(m);
 					if (log) ln->doMove(m);
 
@@ -1247,7 +1318,7 @@ template<Search::impl::nodeType type, bool log> Score Search::impl::alphaBeta(un
 		_sd.setSkipNullMove(ply, skipBackup);
 
 		tte = transpositionTable::getInstance().probe(posKey);
-		ttMove = tte->getPackedMove();
+		ttMove = tte.getPackedMove();
 	}
 
 
@@ -1271,9 +1342,8 @@ template<Search::impl::nodeType type, bool log> Score Search::impl::alphaBeta(un
 		&& depth >= (PVnode ? 6 * ONE_PLY : 8 * ONE_PLY)
 		&& ttMove
 		&& !excludedMove // Recursive singular Search is not allowed
-		&& tte != nullptr
-		&& tte->isTypeGoodForBetaCutoff()
-		&& tte->getDepth() >= depth - 3 * ONE_PLY;
+		&& tte.isTypeGoodForBetaCutoff()
+		&& tte.getDepth() >= depth - 3 * ONE_PLY;
 
 	while (bestScore <beta  && ( m = mp.getNextMove() ) )
 	{
@@ -1400,6 +1470,7 @@ template<Search::impl::nodeType type, bool log> Score Search::impl::alphaBeta(un
 		}
 
 
+		transpositionTable::getInstance().prefetch(_pos.keyAfter(m));
 		_pos.doMove(m);
 		if (log) ln->doMove(m);
 		Score val;
@@ -1714,10 +1785,28 @@ template<Search::impl::nodeType type, bool log> Score Search::impl::qsearch(unsi
 
 
 	const HashKey& posKey = _getSearchKey();
-	ttEntry* const tte = transpositionTable::getInstance().probe( _pos.getKey() );
-	if (log) ln->logTTprobe(*tte);
-	Move ttMove( tte->getPackedMove() );
+	const short int TTdepth = MovePicker::getQuiescentSearchDepth(inCheck, depth) * ONE_PLY;
+
+	// probe the thread local table first, the main one only if its entry doesn't allow a cutoff
+	bool mainTableEntry = !uciParameters::qsearchHash;
+	ttEntry tte = mainTableEntry ? transpositionTable::getInstance().probe( posKey ) : _qtt.probe( posKey );
+	if( !mainTableEntry && !_canUseTTeValue( PVnode, beta, transpositionTable::scoreFromTT(tte.getValue(), ply), tte, TTdepth ) )
+	{
+		// the main table can hold a deeper entry of the same position
+		const ttEntry mainTte = transpositionTable::getInstance().probe( posKey );
+		if( mainTte.getType() != typeVoid )
+		{
+			tte = mainTte;
+			mainTableEntry = true;
+		}
+	}
+	if (log) ln->logTTprobe(tte);
+	Move ttMove( tte.getPackedMove() );
 	if(!_pos.isMoveLegal(ttMove)) {
+		if( ttMove )
+		{
+			ttStatistics::count( ttStatistics::keyCollisions );
+		}
 		ttMove = Move::NOMOVE;
 	}
 	
@@ -1733,13 +1822,17 @@ template<Search::impl::nodeType type, bool log> Score Search::impl::qsearch(unsi
 
 	MovePicker mp(_pos, _sd, ply, ttMove);
 	
-	short int TTdepth = mp.setupQuiescentSearch(inCheck, depth) * ONE_PLY;
-	Score ttValue = transpositionTable::scoreFromTT(tte->getValue(), ply);
+	mp.setupQuiescentSearch(inCheck, depth);
+	Score ttValue = transpositionTable::scoreFromTT(tte.getValue(), ply);
 
 	if (log) ln->test("CanUseTT");
 	if( _canUseTTeValue( PVnode, beta, ttValue, tte, TTdepth ) )
 	{
-		transpositionTable::getInstance().refresh(*tte);
+		ttStatistics::count( ttStatistics::cutoffs );
+		if( mainTableEntry )
+		{
+			transpositionTable::getInstance().refresh(posKey);
+		}
 		if constexpr (PVnode)
 		{
 			_appendTTmoveIfLegal( ttMove, pvLine);
@@ -1755,7 +1848,14 @@ template<Search::impl::nodeType type, bool log> Score Search::impl::qsearch(unsi
 
 	if (log) ln->startSection("calc eval");
 
-	Score staticEval = (tte->getType() != typeVoid) ? tte->getStaticValue() : _pos.eval<false>();
+	bool exactEval = true;
+	Score staticEval = (tte.getType() != typeVoid) ? tte.getStaticValue() : SCORE_NONE;
+	if( staticEval == SCORE_NONE )
+	{
+		staticEval = inCheck ? _staticEval() : _staticEval( alpha, beta, exactEval );
+	}
+	// an estimate of the lazy evaluation isn't stored as static value, the other searches expect the full evaluation
+	const Score ttStaticEval = exactEval ? staticEval : SCORE_NONE;
 	if (log) ln->calcStaticEval(staticEval);
 #ifdef DEBUG_EVAL_SIMMETRY
 	testSimmetry(_pos);
@@ -1774,8 +1874,8 @@ template<Search::impl::nodeType type, bool log> Score Search::impl::qsearch(unsi
 		if( /*!PVnode && */ttValue != SCORE_NONE)
 		{
 			if (
-					( tte->isTypeGoodForBetaCutoff() && (ttValue > staticEval) )
-					|| (tte->isTypeGoodForAlphaCutoff() && (ttValue < staticEval) )
+					( tte.isTypeGoodForBetaCutoff() && (ttValue > staticEval) )
+					|| (tte.isTypeGoodForAlphaCutoff() && (ttValue < staticEval) )
 			)
 			{
 				bestScore = ttValue;
@@ -1802,7 +1902,7 @@ template<Search::impl::nodeType type, bool log> Score Search::impl::qsearch(unsi
 				}
 				if(!_stop)
 				{
-					transpositionTable::getInstance().store(posKey, transpositionTable::scoreToTT(bestScore, ply), typeScoreHigherThanBeta,(short int)TTdepth, ttMove, staticEval);
+					_storeQsearch(posKey, transpositionTable::scoreToTT(bestScore, ply), typeScoreHigherThanBeta,(short int)TTdepth, ttMove, ttStaticEval);
 				}
 				if (log) ln->logReturnValue(bestScore);
 				if (log) ln->endSection();
@@ -1922,6 +2022,7 @@ template<Search::impl::nodeType type, bool log> Score Search::impl::qsearch(unsi
 
 		}
 		
+		transpositionTable::getInstance().prefetch(_pos.keyAfter(m));
 		_pos.doMove(m);
 		if (log) ln->doMove(m);
 		Score val = -qsearch<childNodesType, log>(ply+1, depth - ONE_PLY, -beta, -alpha, childPV);
@@ -1952,7 +2053,7 @@ template<Search::impl::nodeType type, bool log> Score Search::impl::qsearch(unsi
 					}
 					if(!_stop)
 					{
-						transpositionTable::getInstance().store(posKey, transpositionTable::scoreToTT(bestScore, ply), typeScoreHigherThanBeta,(short int)TTdepth, bestMove, staticEval);
+						_storeQsearch(posKey, transpositionTable::scoreToTT(bestScore, ply), typeScoreHigherThanBeta,(short int)TTdepth, bestMove, ttStaticEval);
 					}
 					if (log) ln->logReturnValue(bestScore);
 					if (log) ln->endSection();
@@ -1979,7 +2080,7 @@ template<Search::impl::nodeType type, bool log> Score Search::impl::qsearch(unsi
 
 	if( !_stop )
 	{
-		transpositionTable::getInstance().store(posKey, transpositionTable::scoreToTT(bestScore, ply), TTtype, (short int)TTdepth, bestMove, staticEval);
+		_storeQsearch(posKey, transpositionTable::scoreToTT(bestScore, ply), TTtype, (short int)TTdepth, bestMove, ttStaticEval);
 	}
 	if (log) ln->logReturnValue(bestScore);
 	return bestScore;
@@ -2053,9 +2154,9 @@ Move Search::impl::_getPonderMoveFromHash(const Move& bestMove )
 	Move ponderMove(0);
 	_pos.doMove( bestMove );
 	
-	const ttEntry* const tte = transpositionTable::getInstance().probe(_pos.getKey());
+	const ttEntry tte = transpositionTable::getInstance().probe(_pos.getKey());
 	
-	Move m( tte->getPackedMove() );
+	Move m( tte.getPackedMove() );
 	if( _pos.isMoveLegal(m) )
 	{
 		ponderMove = m;
@@ -2186,6 +2287,10 @@ SearchResult Search::impl::manageNewSearch()
 	//-----------------------------
 
 	_UOI->printGeneralInfo( transpositionTable::getInstance().getFullness(), getTbHits(), getVisitedNodes(), _st.getElapsedTime());
+	if constexpr ( ttStatistics::enabled )
+	{
+		_UOI->printInfoString( ttStatistics::format( ttStatistics::get() ) );
+	}
 	
 	Move bestMove = PV.getMove(0);
 	Move ponderMove = PV.getMove(1);
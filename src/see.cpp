@@ -64,6 +64,12 @@ Score Position::see(const Move& m) const
 		swapList[0] += pieceValue[whiteQueens + m.getPromotionType()][0] - pieceValue[whitePawns][0];
 	}
 
+	// If the opponent attacks neither the destination square nor the moving piece ( x-ray ) there is no recapture
+	if( !m.isEnPassantMove() && !( getActualState().getAttacks( isBlackPiece( getPieceAt(from) ) ? whitePieces : blackPieces ) & ( bitSet(from) | bitSet(to) ) ) )
+	{
+		return swapList[0];
+	}
+
 	// Find all attackers to the destination square, with the moving piece
 	// removed, but possibly an X-ray attacker added behind it.
 	bitMap && attackers = getAttackersTo(to, occupied) & occupied;
@@ -17,6 +17,11 @@
 #ifndef STATE_H_
 #define STATE_H_
 
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <type_traits>
+
 #include "bitBoardIndex.h"
 #include "eCastle.h"
 #include "hashKey.h"
@@ -27,11 +32,15 @@
 // struct
 //--------------------------------------------------------
 /*! \brief define the state of the board
+
+	the state is split in two parts: the incremental part is updated by doMove starting from the parent state,
+	the recomputed part is calculated from scratch by doMove after the board has been changed. A new state copies
+	only the incremental part of its parent, the small fields are packed to keep the copy inside three cache lines.
 	\author Marco Belli
 	\version 1.0
 	\date 27/10/2013
 */
-class state
+class alignas(64) state
 {
 
 public:
@@ -47,6 +56,7 @@ public:
 	// cppcheck-suppress uninitMemberVar symbolName=state::_fiftyMoveCnt
 	// cppcheck-suppress uninitMemberVar symbolName=state::_pliesFromNull
 	// cppcheck-suppress uninitMemberVar symbolName=state::_checkingSquares
+	// cppcheck-suppress uninitMemberVar symbolName=state::_attacks
 	// cppcheck-suppress uninitMemberVar symbolName=state::_capturedPiece
 	// cppcheck-suppress uninitMemberVar symbolName=state::_epSquare
 	explicit state(){}
@@ -99,28 +109,28 @@ public:
 
 	inline bool hasEpSquare() const
 	{
-		return _epSquare != squareNone;
+		return _epSquare != (uint8_t)squareNone;
 	}
 
 	inline bool isEpSquare( const tSquare s) const
 	{
-		return _epSquare == s;
+		return _epSquare == (uint8_t)s;
 	}
 
 	inline tSquare getEpSquare() const
 	{
 		assert( _epSquare < squareNumber || _epSquare == squareNone);
-		return _epSquare;
+		return (tSquare)_epSquare;
 	}
 
 	inline void resetEpSquare()
 	{
-		_epSquare = squareNone;
+		_epSquare = (uint8_t)squareNone;
 	}
 
 	inline void setEpSquare( const tSquare s )
 	{
-		_epSquare = s;
+		_epSquare = (uint8_t)s;
 	}
 
 	inline unsigned int getPliesFromNullCount() const
@@ -144,7 +154,7 @@ public:
 
 	inline void setIrreversibleMoveCount(unsigned int x)
 	{
-		_fiftyMoveCnt = x;
+		_fiftyMoveCnt = (uint16_t)x;
 	}
 
 	inline void resetIrreversibleMoveCount()
@@ -213,9 +223,9 @@ public:
 		return _castleRights & calcCastleRight( cr, c );
 	};
 
-	inline const eCastle& getCastleRights() const
+	inline eCastle getCastleRights() const
 	{
-		return _castleRights;
+		return (eCastle)_castleRights;
 	}
 
 	inline bool hasCastleRights() const
@@ -225,17 +235,17 @@ public:
 
 	inline void clearCastleRight()
 	{
-		_castleRights = (eCastle)0;
+		_castleRights = 0;
 	}
 
 	inline void clearCastleRight( const eCastle c )
 	{
-		_castleRights = (eCastle)(_castleRights & ( ~c ) );
+		_castleRights &= (uint8_t)~c;
 	}
 
 	inline void setCastleRight( const eCastle c )
 	{
-		_castleRights = (eCastle)( _castleRights | c );
+		_castleRights |= (uint8_t)c;
 	}
 
 	inline const Move& getCurrentMove() const
@@ -285,12 +295,12 @@ public:
 
 	inline void setNextTurn( const eNextMove nm )
 	{
-		_nextMove = nm;
+		_nextMove = (uint8_t)nm;
 	}
 
 	inline eNextMove getNextTurn() const
 	{
-		return _nextMove;
+		return (eNextMove)_nextMove;
 	}
 
 	inline bitboardIndex getPiecesOfActivePlayer() const
@@ -335,7 +345,7 @@ public:
 
 	inline void changeNextTurn()
 	{
-		_nextMove = getSwitchedTurn();
+		_nextMove = (uint8_t)getSwitchedTurn();
 	}
 
 	inline eNextMove getSwitchedTurn() const
@@ -343,73 +353,115 @@ public:
 		return (eNextMove)( blackTurn - _nextMove );
 	}
 
+	/*! \brief the check info (hidden checkers and checking squares) is calculated by Position on first use and memoized in the state */
+	inline bool hasCheckInfo() const
+	{
+		return _checkInfo;
+	}
+
+	inline void resetCheckInfo()
+	{
+		_checkInfo = false;
+	}
+
+	inline void setCheckInfo() const
+	{
+		_checkInfo = true;
+	}
+
 	inline bool thereAreHiddenCheckers() const
 	{
+		assert( _checkInfo );
 		return _hiddenCheckersCandidate;
 	}
-	inline void setHiddenCheckers( const bitMap & b )
+
+	inline void setHiddenCheckers( const bitMap & b ) const
 	{
 		_hiddenCheckersCandidate = b;
 	}
 
 	inline bool isHiddenChecker( const tSquare& sq ) const
 	{
+		assert( _checkInfo );
 		return isSquareSet(_hiddenCheckersCandidate, sq );
 	}
 	
-	inline void setHiddenChecker( const bitMap & b )
+	/*! \brief the checking squares are stored only for the pieces of the active player, indexed by piece type */
+	inline void setCheckingSquares( const bitboardIndex piece, const bitMap & b ) const
 	{
-		_hiddenCheckersCandidate = b;
+		assert( isBlackPiece( piece ) == isBlackTurn() );
+		_checkingSquares[ getPieceType( piece ) - King ] = b;
 	}
 	
-	inline void setCheckingSquares( const bitboardIndex piece, const bitMap & b )
+	inline bitMap getCheckingSquares( const bitboardIndex piece ) const
 	{
-		_checkingSquares[ piece ] = b;
+		assert( _checkInfo );
+		assert( isBlackPiece( piece ) == isBlackTurn() );
+		return _checkingSquares[ getPieceType( piece ) - King ];
 	}
 	
-	inline void resetCheckingSquares( const bitboardIndex piece )
+	inline void setAttacks( const bitboardIndex piece, const bitMap & b )
 	{
-		_checkingSquares[ piece ] = 0;
+		_attacks[ piece ] = b;
 	}
-	
-	inline const bitMap& getCheckingSquares( const bitboardIndex piece ) const
+
+	inline const bitMap& getAttacks( const bitboardIndex piece ) const
 	{
-		return _checkingSquares[ piece ];
+		return _attacks[ piece ];
 	}
-	
-	inline const bitboardIndex& getCapturedPiece() const
+
+	inline bitboardIndex getCapturedPiece() const
 	{
-		return _capturedPiece;
+		return (bitboardIndex)_capturedPiece;
 	}
 	
 	inline void setCapturedPiece( const bitboardIndex p )
 	{
-		_capturedPiece = p;
+		_capturedPiece = (uint8_t)p;
 	}
 	
 	inline void resetCapturedPiece()
 	{
-		_capturedPiece = empty;
+		_capturedPiece = (uint8_t)empty;
+	}
+
+	/*! \brief copy the incremental part of a state, the recomputed part is left to doMove */
+	inline void copyIncremental( const state& other )
+	{
+		std::memcpy( static_cast<void*>( this ), &other, incrementalSize() );
+	}
+
+	static constexpr size_t incrementalSize()
+	{
+		return offsetof( state, _currentMove );
 	}
 
 private:
-	eCastle _castleRights; /*!<  actual castle rights*/
-	Move _currentMove;
-	bitMap _pinnedPieces;	/*!< pinned pieces*/
-	bitMap _checkers;	/*!< checking pieces*/
-	eNextMove _nextMove; /*!< who is the active player*/
-	bitMap _hiddenCheckersCandidate;	/*!< pieces who can make a discover check moving*/
+	// incremental part, copied from the parent state
 	simdScore _material;
 	simdScore _nonPawnMaterial; /*!< four score used for white/black opening/endgame non pawn material sum*/
-	unsigned int _fiftyMoveCnt;	/*!<  50 move count used for draw rule*/
-	unsigned int _pliesFromNull;	/*!<  plies from null move*/
-	bitMap _checkingSquares[lastBitboard]; /*!< squares of the board from where a king can be checked*/
-	bitboardIndex _capturedPiece; /*!<  index of the captured piece for unmakeMove*/
-	tSquare _epSquare;	/*!<  en passant square*/
 	HashKey _key,		/*!<  hashkey identifying the position*/
 			_pawnKey,	/*!<  hashkey identifying the pawn formation*/
 			_materialKey;/*!<  hashkey identifying the material signature*/
-
+	bitMap _attacks[lastBitboard]; /*!< squares attacked by each piece type, whitePieces/blackPieces hold the union of each side*/
+	uint16_t _fiftyMoveCnt;	/*!<  50 move count used for draw rule*/
+	uint16_t _pliesFromNull;	/*!<  plies from null move*/
+	uint8_t _castleRights; /*!<  actual castle rights*/
+	uint8_t _epSquare;	/*!<  en passant square*/
+	uint8_t _nextMove; /*!< who is the active player*/
+
+	// recomputed part, calculated by doMove for every new state, the check info only when it's needed
+	Move _currentMove;
+	uint8_t _capturedPiece; /*!<  index of the captured piece for unmakeMove*/
+	mutable bool _checkInfo;	/*!< the hidden checkers and the checking squares have been calculated*/
+	bitMap _checkers;	/*!< checking pieces*/
+	bitMap _pinnedPieces;	/*!< pinned pieces*/
+	mutable bitMap _hiddenCheckersCandidate;	/*!< pieces who can make a discover check moving*/
+	mutable bitMap _checkingSquares[6]; /*!< squares of the board from where the pieces of the active player give check, indexed by piece type*/
 };
 
+static_assert( std::is_standard_layout<state>::value && std::is_trivially_copyable<state>::value, "state is copied with memcpy" );
+static_assert( state::incrementalSize() <= 192, "the incremental part of state should fit in three cache lines" );
+static_assert( sizeof(state) <= 320, "state has grown, check the layout of its fields" );
+
 #endif
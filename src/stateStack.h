@@ -0,0 +1,141 @@
+/*
+	This file is part of Vajolet.
+
+    Vajolet is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    Vajolet is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with Vajolet.  If not, see <http://www.gnu.org/licenses/>
+*/
+
+#ifndef STATESTACK_H_
+#define STATESTACK_H_
+
+#include <algorithm>
+#include <cassert>
+#include <memory>
+
+#include "state.h"
+
+/*! \brief preallocated stack of the states of a position
+
+	the storage is allocated once with room for the game history and a full search line, so doMove never
+	reallocates during the search. Only a game longer than the preallocated history makes the stack grow,
+	the copies made for a search always have room for a full search line after the copied states.
+*/
+class stateStack
+{
+public:
+	static constexpr unsigned int maxPly = 800;			/*!< longest search line, as the story of SearchData*/
+	static constexpr unsigned int gamePlies = 1024;		/*!< game history that fits in a new stack*/
+
+	stateStack(): _capacity( gamePlies + maxPly ), _states( new state[ _capacity ] ){}
+
+	stateStack( const stateStack& other ): _capacity( std::max( gamePlies, other._size ) + maxPly ), _states( new state[ _capacity ] )
+	{
+		assignLast( other, other._size );
+	}
+
+	stateStack& operator=( const stateStack& other )
+	{
+		if( this != &other )
+		{
+			assignLast( other, other._size );
+		}
+		return *this;
+	}
+
+	/*! \brief copy the last n states of other, the stack keeps room for a search after them */
+	void assignLast( const stateStack& other, const unsigned int n )
+	{
+		assert( n >= 1 && n <= other._size );
+		if( n + maxPly > _capacity )
+		{
+			_reallocate( n + maxPly );
+		}
+		std::copy( other._states.get() + other._size - n, other._states.get() + other._size, _states.get() );
+		_size = n;
+	}
+
+	inline void push( const state& s )
+	{
+		if( _size == _capacity )
+		{
+			_grow( s );
+			return;
+		}
+		_states[ _size++ ] = s;
+	}
+
+	/*! \brief push a new state, all its fields are set by the caller */
+	inline state& emplace()
+	{
+		if( _size == _capacity )
+		{
+			_reallocate( 2 * _capacity );
+		}
+		return _states[ _size++ ];
+	}
+
+	/*! \brief push a state copying only the incremental part of s, the caller calculates the rest */
+	inline void pushIncremental( const state& s )
+	{
+		if( _size == _capacity )
+		{
+			_grow( s );
+			return;
+		}
+		_states[ _size++ ].copyIncremental( s );
+	}
+
+	inline void pop()
+	{
+		assert( _size > 1 );
+		--_size;
+	}
+
+	inline void clear()
+	{
+		_size = 0;
+	}
+
+	inline unsigned int size() const { return _size; }
+	inline unsigned int capacity() const { return _capacity; }
+
+	inline state& back() { assert( _size > 0 ); return _states[ _size - 1 ]; }
+	inline const state& back() const { assert( _size > 0 ); return _states[ _size - 1 ]; }
+	inline state& operator[]( const unsigned int n ) { assert( n < _size ); return _states[ n ]; }
+	inline const state& operator[]( const unsigned int n ) const { assert( n < _size ); return _states[ n ]; }
+
+private:
+	unsigned int _size = 0;
+	unsigned int _capacity;
+	std::unique_ptr<state[]> _states;
+
+	/*! \brief move the states in a new storage, a cold path kept out of the callers */
+	[[gnu::noinline, gnu::cold]] void _reallocate( const unsigned int capacity )
+	{
+		assert( capacity > _size );
+		std::unique_ptr<state[]> states( new state[ capacity ] );
+		std::copy( _states.get(), _states.get() + _size, states.get() );
+		_states = std::move( states );
+		_capacity = capacity;
+	}
+
+	/*! \brief push on a full stack, s can be one of the states of the stack */
+	[[gnu::noinline, gnu::cold]] void _grow( const state& s )
+	{
+		const state copy = s;
+		_reallocate( 2 * _capacity );
+		_states[ _size++ ] = copy;
+	}
+};
+
+#endif /* STATESTACK_H_ */
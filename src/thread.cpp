@@ -226,6 +226,7 @@ inline void my_thread::impl::startThinking( const Position& p, SearchLimits& l)
 	_timerCond.wait( lckt, [&]{ return _timerStatus == threadStatus::ready; } );
 
 	_limits = l;
+	// a full copy, the game bookkeeping of the search compares the whole history of the position
 	_src.getPosition() = p;
 	_startThink = true;
 	_searchCond.notify_one();
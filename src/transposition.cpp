@@ -15,72 +15,313 @@
     along with Vajolet.  If not, see <http://www.gnu.org/licenses/>
 */
 
+#include <cerrno>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iomanip>
 #include <iostream>
+#include <mutex>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#if defined(_WIN32)
+#include <malloc.h>
+#endif
+#if defined(__linux__) || defined(__APPLE__)
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
 
 #include "hashKey.h"
 #include "move.h"
 #include "transposition.h"
+#include "uciParameters.h"
 #include "vajolet.h"
 
 
-inline void ttEntry::save(unsigned int Key, Score Value, unsigned char Type, signed short int Depth, unsigned short Move, Score StaticValue, unsigned char gen)
+static const size_t largePageSize = 2 * 1024 * 1024;
+
+/*! \brief allocate the table memory
+	try explicit huge pages from hugetlbfs first, then 2MB aligned memory advised to be backed by transparent huge pages,
+	falling back to normal pages if none of them is available. the memory is not initialized.
+*/
+bool transpositionTable::_allocate(size_t size, bool useLargePages)
 {
-	key = Key;
-	value = Value;
-	staticValue = StaticValue;
-	if(Move)
+	// round the size up to a multiple of the huge page size
+	size = ( ( size + largePageSize - 1 ) / largePageSize ) * largePageSize;
+	void * mem = nullptr;
+
+#if defined(__linux__) && defined(MAP_HUGETLB)
+	if( useLargePages )
+	{
+		mem = mmap( nullptr, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0 );
+		if( mem != MAP_FAILED )
+		{
+			_table = static_cast<ttCluster*>( mem );
+			_tableSize = size;
+			_memoryType = memoryType::hugeTlb;
+			return true;
+		}
+		mem = nullptr;
+	}
+#endif
+
+#if defined(_WIN32)
+	mem = _aligned_malloc( size, largePageSize );
+#else
+	if( posix_memalign( &mem, largePageSize, size ) )
 	{
-		packedMove = Move;
+		mem = nullptr;
 	}
-	depth = Depth;
-	generation = gen;
-	type = Type;
+#endif
+	if( !mem )
+	{
+		return false;
+	}
+
+	_memoryType = memoryType::standard;
+#if defined(__linux__) && defined(MADV_HUGEPAGE)
+	// the advice has to be given before the pages are touched for the first time by clear()
+	if( useLargePages && !madvise( mem, size, MADV_HUGEPAGE ) )
+	{
+		_memoryType = memoryType::transparentHugePages;
+	}
+#else
+	(void)useLargePages;
+#endif
+
+	_table = static_cast<ttCluster*>( mem );
+	_tableSize = size;
+	return true;
 }
 
-inline void ttEntry::setGeneration(unsigned char gen)
+/*! \brief attach to the shared memory segment named _sharedName, creating it if it doesn't exist
+	a segment created by another process keeps its size, whatever the size requested
+*/
+bool transpositionTable::_allocateShared(size_t size)
 {
-	generation = gen;
+#if defined(__linux__) || defined(__APPLE__)
+	const std::string name = _sharedName[0] == '/' ? _sharedName : "/" + _sharedName;
+	const size_t totalSize = sizeof(sharedHeader) + size;
+	bool creator = true;
+
+	int fd = shm_open( name.c_str(), O_RDWR | O_CREAT | O_EXCL, 0666 );
+	if( fd < 0 )
+	{
+		if( errno != EEXIST )
+		{
+			return false;
+		}
+		creator = false;
+		fd = shm_open( name.c_str(), O_RDWR, 0666 );
+		if( fd < 0 )
+		{
+			return false;
+		}
+	}
+
+	void * mem = MAP_FAILED;
+	size_t mappedSize = totalSize;
+	if( creator )
+	{
+		// the pages of a new segment are zero filled, that's an empty table
+		if( !ftruncate( fd, off_t( totalSize ) ) )
+		{
+			mem = mmap( nullptr, totalSize, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0 );
+		}
+		if( mem == MAP_FAILED )
+		{
+			close( fd );
+			shm_unlink( name.c_str() );
+			return false;
+		}
+		sharedHeader * h = static_cast<sharedHeader*>( mem );
+		h->version = _fileVersion;
+		h->elements = _elements;
+		h->magic.store( 0x54544A56, std::memory_order_release );
+	}
+	else
+	{
+		// wait for the creator to initialize the header
+		struct stat st;
+		for( unsigned int i = 0; i < 5000 && ( fstat( fd, &st ) || size_t( st.st_size ) < sizeof(sharedHeader) ); ++i )
+		{
+			std::this_thread::sleep_for( std::chrono::milliseconds( 1 ) );
+		}
+		mappedSize = size_t( st.st_size );
+		if( mappedSize >= sizeof(sharedHeader) )
+		{
+			mem = mmap( nullptr, mappedSize, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0 );
+		}
+		if( mem == MAP_FAILED )
+		{
+			close( fd );
+			return false;
+		}
+		sharedHeader * h = static_cast<sharedHeader*>( mem );
+		for( unsigned int i = 0; i < 5000 && h->magic.load( std::memory_order_acquire ) != 0x54544A56; ++i )
+		{
+			std::this_thread::sleep_for( std::chrono::milliseconds( 1 ) );
+		}
+		if( h->magic.load( std::memory_order_acquire ) != 0x54544A56
+			|| h->version != _fileVersion
+			|| mappedSize != sizeof(sharedHeader) + h->elements * sizeof(ttCluster) )
+		{
+			munmap( mem, mappedSize );
+			close( fd );
+			return false;
+		}
+		_elements = h->elements;
+	}
+	close( fd );
+
+	_sharedHeader = static_cast<sharedHeader*>( mem );
+	_table = reinterpret_cast<ttCluster*>( static_cast<char*>( mem ) + sizeof(sharedHeader) );
+	_tableSize = mappedSize;
+	_memoryType = memoryType::sharedMemory;
+	_generation = (unsigned char)( _sharedHeader->generation.load( std::memory_order_relaxed ) & 0x3F );
+	return true;
+#else
+	(void)size;
+	return false;
+#endif
 }
 
+void transpositionTable::_free()
+{
+	if( !_table )
+	{
+		return;
+	}
+#if defined(__linux__) || defined(__APPLE__)
+	if( _memoryType == memoryType::sharedMemory )
+	{
+		// the segment is not unlinked, other processes may be using it
+		munmap( _sharedHeader, _tableSize );
+		_sharedHeader = nullptr;
+	}
+	else
+#endif
+#if defined(__linux__) && defined(MAP_HUGETLB)
+	if( _memoryType == memoryType::hugeTlb )
+	{
+		munmap( _table, _tableSize );
+	}
+	else
+#endif
+	{
+#if defined(_WIN32)
+		_aligned_free( _table );
+#else
+		free( _table );
+#endif
+	}
+	_table = nullptr;
+	_tableSize = 0;
+	_memoryType = memoryType::standard;
+}
+
+const char* transpositionTable::getMemoryTypeName() const
+{
+	switch( _memoryType )
+	{
+	case memoryType::hugeTlb:
+		return "hugetlbfs huge pages";
+	case memoryType::transparentHugePages:
+		return "transparent huge pages";
+	case memoryType::sharedMemory:
+		return "shared memory";
+	default:
+		return "normal pages";
+	}
+}
 
-unsigned long int transpositionTable::setSize(unsigned long int mbSize)
+unsigned long int transpositionTable::setSize(unsigned long int mbSize, bool useLargePages)
 {
 
 	long long unsigned int size = (long unsigned int)( ((unsigned long long int)mbSize << 20) / sizeof(ttCluster));
 	_elements = size;
 
-	_table.clear();
-	_table.shrink_to_fit();
-	try
+	_mbSize = mbSize;
+	_useLargePages = useLargePages;
+
+	_free();
+	if( !_sharedName.empty() )
 	{
-		_table.resize(_elements);
+		if( _allocateShared( _elements * sizeof(ttCluster) ) )
+		{
+			// the content of the segment is owned by all the attached processes
+			return _elements * ttCluster::entries;
+		}
+		std::cerr << "Failed to attach to shared memory segment " << _sharedName << ", using a private transposition table." << std::endl;
 	}
-	catch(...)
+	if( !_allocate( _elements * sizeof(ttCluster), useLargePages ) )
 	{
 		std::cerr << "Failed to allocate " << mbSize<< "MB for transposition table." << std::endl;
 		exit(EXIT_FAILURE);
 	}
-	return _elements * 4;
+	clear();
+	return _elements * ttCluster::entries;
 }
 
-void transpositionTable::newSearch() {_generation++;}
+/*! \brief select the name of the shared memory segment holding the table, an empty name means a private table
+	the table is reallocated with the last size requested
+*/
+unsigned long int transpositionTable::setSharedName(const std::string& name)
+{
+	if( name != _sharedName || !_table )
+	{
+		_sharedName = name;
+		setSize( _mbSize, _useLargePages );
+	}
+	return _elements * ttCluster::entries;
+}
 
-static ttEntry null(0,SCORE_NONE, typeVoid, -100, 0, 0, 0);
-ttEntry* transpositionTable::probe( const HashKey& k )
+/*! \brief start a new search generation
+	with a shared table the counter is common to all the processes: every new search of any process advances it and the process adopts the new value,
+	so the entries stored by processes still searching with an older generation are the first to be replaced.
+*/
+void transpositionTable::newSearch()
+{
+	if( _sharedHeader )
+	{
+		_generation = (unsigned char)( ( _sharedHeader->generation.fetch_add( 1, std::memory_order_relaxed ) + 1 ) & 0x3F );
+	}
+	else
+	{
+		_generation = ( _generation + 1 ) & 0x3F;
+	}
+}
+
+static const ttEntry null(0,SCORE_NONE, typeVoid, -100, 0, 0, 0);
+ttEntry transpositionTable::probe( const HashKey& k )
 {
 
 	const auto key = k.getKey();
 
 	ttCluster& ttc = findCluster(key);
-	unsigned int keyH = (unsigned int)(key >> 32);
+	unsigned int keyH = getEntryKey(k);
+
+	ttStatistics::count( ttStatistics::probes );
 
-	auto it = std::find_if (ttc.begin(), ttc.end(), [keyH](ttEntry p){return p.getKey()==keyH;});
-	if( it != ttc.end())
+	// work on a copy of the entry, if it has been torn by a concurrent store the key check fails
+	for( unsigned int i = 0; i < ttCluster::entries; ++i )
 	{
-		return it;
+		const ttEntry tte = ttc.load( i );
+		if( tte.getKey() == keyH && !tte.isEmpty() )
+		{
+			ttStatistics::count( ttStatistics::hits );
+			return tte;
+		}
 	}
 
-	return &null;
+	return null;
 }
 
 
@@ -96,55 +337,126 @@ void transpositionTable::store(const HashKey& k, Score value, unsigned char type
 	}
 
 	const auto key = k.getKey();
-	ttEntry *candidate;
-	unsigned int keyH = (unsigned int)(key >> 32); // Use the high 32 bits as key inside the cluster
+	unsigned int keyH = getEntryKey(k); // the upper bits select the cluster, the lower 16 bits are the key inside the cluster
 
 	ttCluster& ttc = findCluster(key);
 
-	auto it = std::find_if (ttc.begin(), ttc.end(), [keyH](ttEntry p){return (!p.getKey()) || (p.getKey()==keyH);});
-	if( it != ttc.end())
+	std::array<ttEntry, ttCluster::entries> entries = { ttc.load(0), ttc.load(1), ttc.load(2) };
+	unsigned int candidate = 0;
+
+	auto it = std::find_if (entries.begin(), entries.end(), [keyH](const ttEntry& p){return p.isEmpty() || (p.getKey()==keyH);});
+	if( it != entries.end())
 	{
-		candidate = it;
+		candidate = std::distance( entries.begin(), it );
 	}
 	else
 	{
-		candidate = &ttc[0];
-		for(auto& d: ttc)
+		for( unsigned int i = 0; i < entries.size(); ++i )
 		{
+			const ttEntry& d = entries[i];
 			bool cc1,cc2,cc3,cc4;
 
-			cc1 = candidate->getGeneration() == _generation;
+			cc1 = entries[candidate].getGeneration() == _generation;
 			cc2 = d.getGeneration() == _generation;
 			cc3 = d.getType() == typeExact;
-			cc4 = d.getDepth() < candidate->getDepth();
+			cc4 = d.getDepth() < entries[candidate].getDepth();
 
 
 			if( (cc1 && cc4) || (!(cc2 || cc3) && (cc4 || cc1)) )
 			{
-				candidate = &d;
+				candidate = i;
 			}
 
 		}
 	}
-	assert(candidate != nullptr);
-	candidate->save(keyH, value, type, depth, move.getPacked(), statValue, _generation);
+	assert(candidate < entries.size());
+
+	ttStatistics::count( ttStatistics::stores );
+	if( entries[candidate].isEmpty() )
+	{
+		// nothing is lost
+	}
+	else if( entries[candidate].getKey() == keyH )
+	{
+		ttStatistics::count( ttStatistics::sameKeyStores );
+	}
+	else
+	{
+		static const ttStatistics::counter overwrittenType[] = { ttStatistics::overwrittenExact, ttStatistics::overwrittenLower, ttStatistics::overwrittenUpper, ttStatistics::overwrites };
+		ttStatistics::count( ttStatistics::overwrites );
+		ttStatistics::count( overwrittenType[ std::min( (unsigned int)entries[candidate].getType(), 3u ) ] );
+		// depths are stored in 1/16 of ply
+		if( entries[candidate].getDepth() >= 8 * 16 )
+		{
+			ttStatistics::count( ttStatistics::overwrittenDeep );
+		}
+	}
+	unsigned short packedMove = move.getPacked() ? move.getPacked() : entries[candidate].getPackedMove();
+	ttc.save( candidate, ttEntry(keyH, value, type, depth, packedMove, statValue, _generation) );
 
 }
-void transpositionTable::clear()
+/*! \brief split the clusters of the table in uciParameters::threads slices, calling func( begin, end ) for each of them from a different thread
+*/
+void transpositionTable::_parallelForEachCluster(const std::function<void(unsigned long int, unsigned long int)>& func) const
 {
-	ttCluster ttc;
-	ttc.fill(ttEntry(0,0,0,0,0,0,0));
-	std::fill(_table.begin(), _table.end(), ttc);
+	const unsigned long int threadsNumber = std::max( 1u, std::min<unsigned int>( uciParameters::threads, _elements ) );
+	const unsigned long int slice = ( _elements + threadsNumber - 1 ) / threadsNumber;
+
+	auto doSlice = [this, slice, &func]( unsigned long int idx )
+	{
+		const unsigned long int start = idx * slice;
+		const unsigned long int end = std::min( start + slice, _elements );
+		if( start < end )
+		{
+			func( start, end );
+		}
+	};
+
+	std::vector<std::thread> workers;
+	for( unsigned long int idx = 1; idx < threadsNumber; ++idx )
+	{
+		workers.emplace_back( doSlice, idx );
+	}
+	doSlice( 0 );
+	for( auto& t: workers )
+	{
+		t.join();
+	}
 }
 
-inline ttCluster& transpositionTable::findCluster(uint64_t key)
+/*! \brief zero the table splitting the work among uciParameters::threads workers
+	each thread touches its own slice, so on NUMA machines the pages are first touched by the threads that will use them
+*/
+void transpositionTable::clear()
 {
-	return _table[ static_cast<size_t>(((unsigned int)key) % _elements) ];
+	if( !_table )
+	{
+		return;
+	}
+	_parallelForEachCluster( [this]( unsigned long int start, unsigned long int end )
+	{
+		// an all zero slot is a valid empty entry
+		std::memset( static_cast<void*>( &_table[start] ), 0, ( end - start ) * sizeof(ttCluster) );
+	});
 }
 
-void transpositionTable::refresh(ttEntry& tte)
+void transpositionTable::refresh(const HashKey& k)
 {
-	tte.setGeneration(_generation);
+	const auto key = k.getKey();
+
+	ttCluster& ttc = findCluster(key);
+	unsigned int keyH = getEntryKey(k);
+
+	for( unsigned int i = 0; i < ttCluster::entries; ++i )
+	{
+		const ttEntry tte = ttc.load( i );
+		if( tte.getKey() == keyH && !tte.isEmpty() )
+		{
+			ttStatistics::count( ttStatistics::refreshes );
+			ttc.save( i, ttEntry(keyH, tte.getValue(), tte.getType(), tte.getDepth(), tte.getPackedMove(), tte.getStaticValue(), _generation) );
+			return;
+		}
+	}
 }
 
 unsigned int transpositionTable::getFullness() const
@@ -152,29 +464,336 @@ unsigned int transpositionTable::getFullness() const
 	unsigned int cnt = 0u;
 	unsigned int end = std::min( 250lu, _elements );
 
-	for (auto t = _table.begin(); t != _table.begin()+end; t++)
+	for (unsigned int i = 0; i < end; ++i)
 	{
-		cnt+= std::count_if (t->begin(), t->end(), [=](ttEntry d){return d.getGeneration() == this->_generation;});
+		for( unsigned int j = 0; j < ttCluster::entries; ++j )
+		{
+			const ttEntry tte = _table[i].load( j );
+			cnt += !tte.isEmpty() && tte.getGeneration() == _generation;
+		}
 	}
-	return (unsigned int)(cnt*250lu/(end));
+	return (unsigned int)(cnt*1000lu/(end * ttCluster::entries));
 }
 
 
+/*! \brief save the table to a file: a fileHeader followed by the clusters
+*/
+bool transpositionTable::saveToFile(const std::string& fileName) const
+{
+	std::ofstream f( fileName, std::ios::binary | std::ios::trunc );
+	if( !f || !_table )
+	{
+		return false;
+	}
+
+	fileHeader h = {};
+	std::memcpy( h.magic, "VJTT", 4 );
+	h.version = _fileVersion;
+	h.elements = _elements;
+	h.generation = _generation;
+
+	f.write( reinterpret_cast<const char*>( &h ), sizeof(h) );
+	f.write( reinterpret_cast<const char*>( _table ), std::streamsize( _elements * sizeof(ttCluster) ) );
+	return bool( f );
+}
+
+/*! \brief move the entries of a table with a different size into the current one
+	only the lower 16 bits of the keys are stored, the upper ones are estimated from the cluster the entry comes from.
+	shrinking the table keeps the most entries but not all of them: the entries of the merged clusters compete for the same slots,
+	growing the table only part of the entries will be found again
+*/
+void transpositionTable::_rehash(const ttCluster* source, unsigned long int elements)
+{
+	_parallelForEachCluster( [this, source, elements]( unsigned long int start, unsigned long int end )
+	{
+		// every thread rehashes the source clusters mapped on its slice of the current table
+		const long double scale = (long double)elements / _elements;
+		const unsigned long int first = (unsigned long int)std::max( 0.0L, start * scale - 1 );
+		const unsigned long int last = std::min( (unsigned long int)( end * scale + 2 ), elements );
+		for( unsigned long int i = first; i < last; ++i )
+		{
+			// middle of the key range mapped on cluster i
+			const double middle = ( i + 0.5 ) / elements * 18446744073709551616.0;
+			const uint64_t keyRange = middle >= 18446744073709551615.0 ? ~0ull : uint64_t( middle );
+			for( unsigned int j = 0; j < ttCluster::entries; ++j )
+			{
+				const ttEntry tte = source[i].load( j );
+				if( tte.isEmpty() )
+				{
+					continue;
+				}
+				const HashKey key( ( keyRange & ~0xFFFFull ) | tte.getKey() );
+				const unsigned long int dest = static_cast<unsigned long int>( &findCluster( key.getKey() ) - _table );
+				// each destination cluster is written by a single thread
+				if( dest >= start && dest < end )
+				{
+					store( key, tte.getValue(), tte.getType(), tte.getDepth(), Move( tte.getPackedMove() ), tte.getStaticValue() );
+				}
+			}
+		}
+	});
+}
+
+/*! \brief load a table saved by saveToFile, rehashing the entries if the file size doesn't match the current one
+*/
+bool transpositionTable::loadFromFile(const std::string& fileName)
+{
+	if( !_table )
+	{
+		return false;
+	}
+
+#if defined(__linux__) || defined(__APPLE__)
+	const int fd = open( fileName.c_str(), O_RDONLY );
+	if( fd < 0 )
+	{
+		return false;
+	}
+	struct stat st;
+	if( fstat( fd, &st ) || size_t( st.st_size ) < sizeof(fileHeader) )
+	{
+		close( fd );
+		return false;
+	}
+	const size_t fileSize = size_t( st.st_size );
+	void * mem = mmap( nullptr, fileSize, PROT_READ, MAP_PRIVATE, fd, 0 );
+	close( fd );
+	if( mem == MAP_FAILED )
+	{
+		return false;
+	}
+	const char * data = static_cast<const char*>( mem );
+#else
+	std::ifstream f( fileName, std::ios::binary | std::ios::ate );
+	if( !f )
+	{
+		return false;
+	}
+	const size_t fileSize = size_t( f.tellg() );
+	std::vector<char> buffer( fileSize );
+	f.seekg( 0 );
+	f.read( buffer.data(), std::streamsize( fileSize ) );
+	if( !f || fileSize < sizeof(fileHeader) )
+	{
+		return false;
+	}
+	const char * data = buffer.data();
+#endif
+
+	fileHeader h;
+	std::memcpy( &h, data, sizeof(h) );
+	const ttCluster * source = reinterpret_cast<const ttCluster*>( data + sizeof(fileHeader) );
+	const bool valid = std::memcmp( h.magic, "VJTT", 4 ) == 0
+		&& h.version == _fileVersion
+		&& h.elements > 0
+		&& fileSize == sizeof(fileHeader) + h.elements * sizeof(ttCluster);
+
+	if( valid )
+	{
+		_generation = h.generation & 0x3F;
+		if( h.elements == _elements )
+		{
+			_parallelForEachCluster( [this, source]( unsigned long int start, unsigned long int end )
+			{
+				std::memcpy( static_cast<void*>( &_table[start] ), &source[start], ( end - start ) * sizeof(ttCluster) );
+			});
+		}
+		else
+		{
+			clear();
+			_rehash( source, h.elements );
+		}
+	}
+
+#if defined(__linux__) || defined(__APPLE__)
+	munmap( mem, fileSize );
+#endif
+	return valid;
+}
+
+#ifdef ENABLE_TT_STATISTICS
+namespace
+{
+	/*! \brief counters of a single thread, merged into the retired ones when the thread exits
+		only the owning thread writes them, relaxed atomics let the reporting thread read them at any time
+	*/
+	struct threadCounters
+	{
+		std::array<std::atomic<uint64_t>, ttStatistics::counterNumber> c;
+		threadCounters();
+		~threadCounters();
+	};
+
+	std::mutex countersMutex;
+	std::vector<threadCounters*> liveCounters;
+	ttStatistics::snapshot retiredCounters = {};
+
+	threadCounters::threadCounters()
+	{
+		for( auto& x: c )
+		{
+			x.store( 0, std::memory_order_relaxed );
+		}
+		std::lock_guard<std::mutex> lock( countersMutex );
+		liveCounters.push_back( this );
+	}
+
+	threadCounters::~threadCounters()
+	{
+		std::lock_guard<std::mutex> lock( countersMutex );
+		for( unsigned int i = 0; i < ttStatistics::counterNumber; ++i )
+		{
+			retiredCounters[i] += c[i].load( std::memory_order_relaxed );
+		}
+		liveCounters.erase( std::find( liveCounters.begin(), liveCounters.end(), this ) );
+	}
+
+	thread_local threadCounters localCounters;
+}
+
+void ttStatistics::_increment(const counter c)
+{
+	auto& x = localCounters.c[c];
+	x.store( x.load( std::memory_order_relaxed ) + 1, std::memory_order_relaxed );
+}
+
+void ttStatistics::reset()
+{
+	std::lock_guard<std::mutex> lock( countersMutex );
+	retiredCounters.fill( 0 );
+	for( auto t: liveCounters )
+	{
+		for( auto& x: t->c )
+		{
+			x.store( 0, std::memory_order_relaxed );
+		}
+	}
+}
+
+ttStatistics::snapshot ttStatistics::get()
+{
+	std::lock_guard<std::mutex> lock( countersMutex );
+	snapshot s = retiredCounters;
+	for( auto t: liveCounters )
+	{
+		for( unsigned int i = 0; i < counterNumber; ++i )
+		{
+			s[i] += t->c[i].load( std::memory_order_relaxed );
+		}
+	}
+	return s;
+}
+#else
+void ttStatistics::reset(){}
+ttStatistics::snapshot ttStatistics::get(){ return snapshot{}; }
+void ttStatistics::_increment(const counter){}
+#endif
+
+std::string ttStatistics::format(const snapshot& s)
+{
+	std::ostringstream ss;
+	ss << std::fixed << std::setprecision(1)
+		<< "tt probes " << s[probes]
+		<< " hits " << s[hits] << " (" << ( s[probes] ? 100.0 * s[hits] / s[probes] : 0.0 ) << "%)"
+		<< " cutoffs " << s[cutoffs]
+		<< " collisions " << s[keyCollisions]
+		<< " stores " << s[stores]
+		<< " samekey " << s[sameKeyStores]
+		<< " overwrites " << s[overwrites]
+		<< " (exact " << s[overwrittenExact]
+		<< " lower " << s[overwrittenLower]
+		<< " upper " << s[overwrittenUpper]
+		<< " deep " << s[overwrittenDeep] << ")"
+		<< " refreshes " << s[refreshes]
+		<< " qsearch probes " << s[qsearchProbes]
+		<< " hits " << s[qsearchHits] << " (" << ( s[qsearchProbes] ? 100.0 * s[qsearchHits] / s[qsearchProbes] : 0.0 ) << "%)"
+		<< " pawn probes " << s[pawnProbes]
+		<< " hits " << s[pawnHits] << " (" << ( s[pawnProbes] ? 100.0 * s[pawnHits] / s[pawnProbes] : 0.0 ) << "%)"
+		<< " eval cache probes " << s[evalCacheProbes]
+		<< " hits " << s[evalCacheHits] << " (" << ( s[evalCacheProbes] ? 100.0 * s[evalCacheHits] / s[evalCacheProbes] : 0.0 ) << "%)";
+	return ss.str();
+}
+
+void evalCache::setSize(const unsigned int mbSize)
+{
+	_mbSize = mbSize;
+	if( !mbSize )
+	{
+		_table.reset();
+		_mask = 0;
+		return;
+	}
+	uint64_t elements = 1;
+	while( elements * 2 * sizeof(uint64_t) <= uint64_t( mbSize ) * 1024 * 1024 )
+	{
+		elements *= 2;
+	}
+	_mask = elements - 1;
+	_table.reset( new std::atomic<uint64_t>[ elements ] );
+	clear();
+}
+
+void evalCache::clear()
+{
+	for( uint64_t i = 0; _mbSize && i <= _mask; ++i )
+	{
+		// an empty entry matches only the keys with all the upper 32 bits set, as unlikely as any collision
+		_table[i].store( _keyMask, std::memory_order_relaxed );
+	}
+}
+
+void PerftTranspositionTable::setSize(unsigned long int mbSize)
+{
+	_mbSize = mbSize;
+	std::vector<perftCluster>().swap( _table );
+}
+
+void PerftTranspositionTable::clear()
+{
+	std::fill( _table.begin(), _table.end(), perftCluster{} );
+}
+
 void PerftTranspositionTable::store(const HashKey& key, signed short int depth, unsigned long long v)
 {
-	transpositionTable::getInstance().store(key, Score(v&0x7FFFFF), typeExact, depth, Move::NOMOVE, (v>>23)&0x7FFFFF);
+	if( _table.empty() )
+	{
+		_table.resize( std::max( 1ul, (unsigned long int)( ( (unsigned long long int)_mbSize << 20 ) / sizeof(perftCluster) ) ) );
+	}
+	perftCluster& c = findCluster( key );
+
+	// replace the entry of the same position and depth, an empty one or the shallowest
+	unsigned int candidate = 0;
+	for( unsigned int i = 0; i < 3; ++i )
+	{
+		if( ( c.key[i] == key.getKey() && c.depth[i] == depth ) || !c.depth[i] )
+		{
+			candidate = i;
+			break;
+		}
+		if( c.depth[i] < c.depth[candidate] )
+		{
+			candidate = i;
+		}
+	}
+	c.key[candidate] = key.getKey();
+	c.count[candidate] = v;
+	c.depth[candidate] = (uint8_t)depth;
 }
 
 bool PerftTranspositionTable::retrieve(const HashKey& key, unsigned int depth, unsigned long long& res)
 {
-	ttEntry* tte = transpositionTable::getInstance().probe( key );
-	
-	if( tte->getKey() == (key.getKey()>>32) && (unsigned int)tte->getDepth() == depth )
+	if( _table.empty() )
 	{
-		res = (unsigned long long)(((unsigned int)tte->getValue())&0x7FFFFF) + (((unsigned long long)((unsigned int)tte->getStaticValue())&0x7FFFFF)<<23);
-
-		return true;
+		return false;
+	}
+	const perftCluster& c = findCluster( key );
+	for( unsigned int i = 0; i < 3; ++i )
+	{
+		if( c.key[i] == key.getKey() && c.depth[i] == depth )
+		{
+			res = c.count[i];
+			return true;
+		}
 	}
 	return false;
-	
 }
@@ -20,13 +20,19 @@
 
 #include <algorithm>
 #include <array>
+#include <atomic>
+#include <cassert>
+#include <cstdlib>
 #include <cstdint>
+#include <functional>
+#include <memory>
+#include <string>
 #include <vector>
 
+#include "hashKey.h"
 #include "score.h"
 #include "vajolet.h"
 
-class HashKey;
 class Move;
 
 enum ttType
@@ -41,29 +47,62 @@ class ttEntry
 {
 private:
 
-	signed int key:32; 			/*! 32 bit for the upper part of the key*/
-	signed int packedMove:16;	/*! 16 bit for the move*/
-	signed int depth:16;		/*! 16 bit for depth*/
-	signed int value:23;		/*! 23 bit for the value*/
-	signed int generation:8;		/*! 8 bit for the generation id*/
-	signed int staticValue:23;	/*! 23 bit for the static evalutation (eval())*/
-	signed int type:3;			/*! 2 bit for the type of the entry*/
-							/*  144 bits total =16 bytes*/
-	inline void save(unsigned int Key, Score Value, unsigned char Type, signed short int Depth, unsigned short Move, Score StaticValue, unsigned char gen);
-	inline void setGeneration(unsigned char gen);
-	
-	friend class transpositionTable;
+	uint64_t _data;		/*! 16 bit for the move, 16 bit for the value, 16 bit for the static evaluation (eval()), 8 bit for depth, 6 bit for the generation id, 2 bit for the type of the entry*/
+	uint16_t _key;		/*! 16 bit for the lower part of the key*/
+						/*  80 bits total = 10 bytes*/
+
+	static constexpr int16_t _noneScore = -32768;
+	static constexpr int16_t _mateScore = 32767;
+	static constexpr int _mateRange = SCORE_MATE - SCORE_MATE_IN_MAX_PLY;
+	static constexpr int _linearRange = 24000;
+	static_assert( _linearRange + ( SCORE_MATE_IN_MAX_PLY - _linearRange ) / 256 + 1 < _mateScore - _mateRange, "the score ranges shall not overlap" );
+
+	explicit ttEntry(const uint16_t key, const uint64_t data): _data(data), _key(key){}
+
+	/*! \brief scores up to _linearRange are stored exactly, bigger ones in steps of 256, mate scores exactly in a band at the ends of the range
+		rounded bounds remain valid bounds
+	*/
+	static uint16_t _packScore(const Score v, const unsigned char type)
+	{
+		if( v == SCORE_NONE ) { return uint16_t( _noneScore ); }
+		if( v >= SCORE_MATE_IN_MAX_PLY ) { return uint16_t( _mateScore - std::min( SCORE_MATE - v, _mateRange ) ); }
+		if( v <= SCORE_MATED_IN_MAX_PLY ) { return uint16_t( -_mateScore + std::min( v - SCORE_MATED, _mateRange ) ); }
+		if( std::abs( v ) <= _linearRange ) { return uint16_t( v ); }
+
+		const int sign = v > 0 ? 1 : -1;
+		const int x = std::abs( v ) - _linearRange;
+		// round an upper bound up, a lower bound down and an exact score to the nearest
+		const bool roundUp = type == typeExact ? ( x & 0xFF ) >= 0x80 : ( x & 0xFF ) && ( ( type == typeScoreLowerThanAlpha ) == ( v > 0 ) );
+		return uint16_t( sign * ( _linearRange + ( x >> 8 ) + roundUp ) );
+	}
+	static Score _unpackScore(const uint64_t x)
+	{
+		const int16_t v = int16_t( uint16_t( x ) );
+		if( v == _noneScore ) { return SCORE_NONE; }
+		if( v >= _mateScore - _mateRange ) { return SCORE_MATE - ( _mateScore - v ); }
+		if( v <= -_mateScore + _mateRange ) { return SCORE_MATED + ( v + _mateScore ); }
+		if( std::abs( v ) <= _linearRange ) { return Score( v ); }
+		return ( v > 0 ? 1 : -1 ) * ( _linearRange + ( std::abs( v ) - _linearRange ) * 256 );
+	}
+	/*! \brief depth is stored in half plies with an offset of 8 plies, 0 is reserved for empty entries
+	*/
+	static uint64_t _packDepth(const signed short int d){ return uint64_t( std::min( std::max( ( d >> 3 ) + 16, 1 ), 255 ) ); }
+
+	friend struct ttCluster;
+	friend class qsearchTable;
 public:
-	explicit ttEntry(unsigned int _Key, Score _Value, unsigned char _Type, signed short int _Depth, unsigned short _Move, Score _StaticValue, unsigned char _gen): key(_Key), packedMove(_Move), depth(_Depth), value(_Value), generation(_gen), staticValue(_StaticValue), type(_Type){}
-	explicit ttEntry(){}
+	explicit ttEntry(unsigned int _Key, Score _Value, unsigned char _Type, signed short int _Depth, unsigned short _Move, Score _StaticValue, unsigned char _gen):
+		_data( ( uint64_t( _Move ) << 48 ) | ( uint64_t( _packScore( _Value, _Type ) ) << 32 ) | ( uint64_t( _packScore( _StaticValue, typeExact ) ) << 16 ) | ( _packDepth( _Depth ) << 8 ) | ( uint64_t( _gen & 0x3F ) << 2 ) | uint64_t( _Type & 0x3 ) ),
+		_key( uint16_t( _Key ) ){}
 
-	inline unsigned int getKey() const{ return key; }
-	Score getValue()const { return value; }
-	Score getStaticValue()const { return staticValue; }
-	unsigned short getPackedMove()const { return packedMove; }
-	signed short int getDepth()const { return depth; }
-	ttType getType()const { return static_cast<ttType>(type); }
-	unsigned char getGeneration()const { return generation; }
+	inline unsigned int getKey() const{ return _key; }
+	Score getValue()const { return _unpackScore( _data >> 32 ); }
+	Score getStaticValue()const { return _unpackScore( _data >> 16 ); }
+	unsigned short getPackedMove()const { return (unsigned short)( _data >> 48 ); }
+	signed short int getDepth()const { return (signed short int)( ( int( ( _data >> 8 ) & 0xFF ) - 16 ) * 8 ); }
+	ttType getType()const { return static_cast<ttType>( _data & 0x3 ); }
+	unsigned char getGeneration()const { return (unsigned char)( ( _data >> 2 ) & 0x3F ); }
+	bool isEmpty()const { return !( _data & 0xFF00 ); }
 
 	bool isTypeGoodForBetaCutoff() const
 	{
@@ -76,29 +115,179 @@ public:
 	
 };
 
-using ttCluster = std::array<ttEntry, 4>;
+/*! \brief a bucket of 3 entries filling half a cache line, with lockless access to the entries
+	the data of an entry is read and written as a whole 64 bit word and the 16 bit key is xored with the data word,
+	so an entry torn by two threads writing at the same time fails the key verification.
+*/
+struct alignas(32) ttCluster
+{
+	static constexpr unsigned int entries = 3;
+
+	std::atomic<uint64_t> _data[entries];
+	std::atomic<uint16_t> _key[entries];
+	uint16_t _padding;
+
+	static uint16_t _fold(uint64_t data){ data ^= data >> 32; data ^= data >> 16; return uint16_t( data ); }
+
+	ttEntry load(const unsigned int i) const
+	{
+		const uint64_t data = _data[i].load( std::memory_order_relaxed );
+		return ttEntry( uint16_t( _key[i].load( std::memory_order_relaxed ) ^ _fold( data ) ), data );
+	}
+
+	void save(const unsigned int i, const ttEntry& e)
+	{
+		_key[i].store( uint16_t( e._key ^ _fold( e._data ) ), std::memory_order_relaxed );
+		_data[i].store( e._data, std::memory_order_relaxed );
+	}
+};
+static_assert( sizeof(ttCluster) == 32, "ttCluster shall fill half a cache line" );
+
+/*! \brief transposition, pawn and evaluation cache counters, collected per thread when ENABLE_TT_STATISTICS is defined
+*/
+class ttStatistics
+{
+public:
+	enum counter
+	{
+		probes,
+		hits,
+		cutoffs,			// hits whose value has been used to return from the node
+		keyCollisions,		// hits with an illegal move, the 16 bit key matched an unrelated position
+		stores,
+		sameKeyStores,		// stores updating an entry of the same position
+		overwrites,			// stores replacing an entry of another position
+		overwrittenExact,
+		overwrittenLower,
+		overwrittenUpper,
+		overwrittenDeep,	// overwritten entries searched at 8 plies or more
+		refreshes,
+		qsearchProbes,		// probes of the per thread quiescence search table
+		qsearchHits,
+		pawnProbes,			// probes of the pawn hash table
+		pawnHits,
+		evalCacheProbes,	// probes of the static evaluation cache
+		evalCacheHits,
+		counterNumber
+	};
+	using snapshot = std::array<uint64_t, counterNumber>;
+
+#ifdef ENABLE_TT_STATISTICS
+	static constexpr bool enabled = true;
+#else
+	static constexpr bool enabled = false;
+#endif
+
+	static inline void count(const counter c)
+	{
+#ifdef ENABLE_TT_STATISTICS
+		_increment(c);
+#else
+		(void)c;
+#endif
+	}
+	static void reset();
+	static snapshot get();
+	static std::string format(const snapshot& s);
+
+private:
+	static void _increment(const counter c);
+};
+
+/*! \brief high 64 bits of the 128 bit product a * b, used to map a key on a table of b elements without a division
+*/
+inline uint64_t mulHigh64(const uint64_t a, const uint64_t b)
+{
+#if defined(__SIZEOF_INT128__)
+	__extension__ typedef unsigned __int128 uint128;
+	return static_cast<uint64_t>( ( static_cast<uint128>( a ) * b ) >> 64 );
+#else
+	const uint64_t aL = uint32_t( a ), aH = a >> 32;
+	const uint64_t bL = uint32_t( b ), bH = b >> 32;
+	const uint64_t c1 = ( aL * bL ) >> 32;
+	const uint64_t c2 = aH * bL + c1;
+	const uint64_t c3 = aL * bH + uint32_t( c2 );
+	return aH * bH + ( c2 >> 32 ) + ( c3 >> 32 );
+#endif
+}
+
 
 
 
 class transpositionTable
 {
+public:
+	enum class memoryType
+	{
+		standard,				// normal pages
+		transparentHugePages,	// 2MB aligned memory advised with madvise(MADV_HUGEPAGE)
+		hugeTlb,				// explicit huge pages from hugetlbfs
+		sharedMemory			// named POSIX shared memory segment shared with other processes
+	};
+
 private:
-	std::vector<ttCluster> _table;
+	/*! \brief header at the beginning of a shared memory segment, the clusters follow it
+	*/
+	struct sharedHeader
+	{
+		std::atomic<uint32_t> magic;		// written last by the process creating the segment
+		uint32_t version;
+		uint64_t elements;
+		std::atomic<uint32_t> generation;	// generation counter common to all the processes
+		uint8_t padding[44];
+	};
+
+	ttCluster* _table;
+	size_t _tableSize;
+	memoryType _memoryType;
 	unsigned long int _elements;
 	unsigned char _generation;
+	unsigned long int _mbSize;
+	bool _useLargePages;
+	std::string _sharedName;
+	sharedHeader* _sharedHeader;
 
 	explicit transpositionTable()
 	{
-		_table.clear();
-		_table.shrink_to_fit();
-
+		_table = nullptr;
+		_tableSize = 0;
+		_memoryType = memoryType::standard;
 		_generation = 0;
 		_elements = 1;
+		_mbSize = 1;
+		_useLargePages = true;
+		_sharedHeader = nullptr;
 	}
+	~transpositionTable(){ _free(); }
 	
 	transpositionTable(transpositionTable const&) = delete;
 	void operator=(transpositionTable const&) = delete;
-	ttCluster& findCluster(uint64_t key);
+	/*! \brief map the key on the table using the high part of key * _elements, avoiding a division and using the whole key
+		the index depends mostly on the upper bits of the key, the lower 16 bits are stored in the entry
+	*/
+	ttCluster& findCluster(uint64_t key) const
+	{
+		return _table[ static_cast<size_t>( mulHigh64( key, _elements ) ) ];
+	}
+	bool _allocate(size_t size, bool useLargePages);
+	bool _allocateShared(size_t size);
+	void _free();
+	void _parallelForEachCluster(const std::function<void(unsigned long int, unsigned long int)>& func) const;
+	void _rehash(const ttCluster* source, unsigned long int elements);
+
+	/*! \brief header of the file saved by saveToFile, the clusters follow it as they are in memory
+	*/
+	struct fileHeader
+	{
+		char magic[4];
+		uint32_t version;
+		uint64_t elements;
+		uint8_t generation;
+		uint8_t padding[47];	// keep the clusters following the header aligned
+	};
+	static_assert( sizeof(fileHeader) == 64, "the file header shall fill a cache line" );
+	static_assert( sizeof(sharedHeader) == 64, "the shared memory header shall fill a cache line" );
+	static constexpr uint32_t _fileVersion = 2;	// to be incremented every time the layout of ttCluster changes
 	
 
 public:
@@ -112,11 +301,25 @@ public:
 	}
 	
 	void newSearch();
-	unsigned long int setSize(unsigned long int mbSize);
-	void refresh(ttEntry& tte);
-	ttEntry* probe(const HashKey& k);
+	unsigned long int setSize(unsigned long int mbSize, bool useLargePages = true);
+	unsigned long int setSharedName(const std::string& name);
+	const std::string& getSharedName() const { return _sharedName; }
+	memoryType getMemoryType() const { return _memoryType; }
+	const char* getMemoryTypeName() const;
+	void refresh(const HashKey& k);
+	ttEntry probe(const HashKey& k);
+	/*! \brief bring the cluster of the key into the cache, to be called as early as possible before the probe
+	*/
+	void prefetch(const HashKey& k) const
+	{
+		__builtin_prefetch( &findCluster( k.getKey() ) );
+	}
+	static unsigned int getEntryKey(const HashKey& k){ return (uint16_t)k.getKey(); }
 	void store(const HashKey& k, Score value, unsigned char type, signed short int depth, const Move& move, Score statValue);
 	unsigned int getFullness() const;
+	unsigned long int getEntries() const { return _elements * ttCluster::entries; }
+	bool saveToFile(const std::string& fileName) const;
+	bool loadFromFile(const std::string& fileName);
 	
 	// value_to_tt() adjusts a mate score from "plies to mate from the root" to
 	// "plies to mate from the current position". Non-mate scores are unchanged.
@@ -151,10 +354,154 @@ public:
 	}
 };
 
+/*! \brief small per thread table holding the quiescence search entries (depth <= 0)
+	it is sized to stay in the L2 cache, so the shallow probes don't pay a memory access
+	and the shallow entries don't evict the deep ones from the main table.
+	being private to a thread it stores the full key and needs no atomic access
+*/
+class qsearchTable
+{
+private:
+	struct qsearchSlot
+	{
+		uint64_t key;
+		uint64_t data;
+	};
+	std::vector<qsearchSlot> _table;
+	uint64_t _mask;
+
+public:
+	static constexpr size_t defaultSize = 256 * 1024;	// bytes
+
+	explicit qsearchTable( const size_t size = defaultSize ): _table( std::max<size_t>( size / sizeof(qsearchSlot), 1 ) ), _mask( _table.size() - 1 )
+	{
+		assert( ( _table.size() & _mask ) == 0 );
+	}
+
+	void clear(){ std::fill( _table.begin(), _table.end(), qsearchSlot{ 0, 0 } ); }
+
+	ttEntry probe( const HashKey& k ) const
+	{
+		const qsearchSlot& s = _table[ k.getKey() & _mask ];
+		ttStatistics::count( ttStatistics::qsearchProbes );
+		if( s.key == k.getKey() && s.data )
+		{
+			ttStatistics::count( ttStatistics::qsearchHits );
+			return ttEntry( uint16_t( s.key ), s.data );
+		}
+		return ttEntry( 0, SCORE_NONE, typeVoid, -100, 0, 0, 0 );
+	}
+
+	/*! \brief always replace, keeping the move of the old entry of the same position if the new one has none
+	*/
+	void store( const HashKey& k, Score value, unsigned char type, signed short int depth, unsigned short packedMove, Score statValue )
+	{
+		qsearchSlot& s = _table[ k.getKey() & _mask ];
+		if( !packedMove && s.key == k.getKey() )
+		{
+			packedMove = ttEntry( uint16_t( s.key ), s.data ).getPackedMove();
+		}
+		s.key = k.getKey();
+		s.data = ttEntry( 0, value, type, depth, packedMove, statValue, 0 )._data;
+	}
+};
+
+/*! \brief cache of the static evaluations, shared by all the threads
+	every entry is a single 64 bit word holding the upper 32 bits of the key and the evaluation,
+	so it's read and written atomically without locks. the lower bits of the key select the entry
+*/
+class evalCache
+{
+private:
+	std::unique_ptr<std::atomic<uint64_t>[]> _table;
+	uint64_t _mask;
+	unsigned int _mbSize;
+
+	explicit evalCache(): _mask(0), _mbSize(0){ setSize( defaultSize ); }
+	evalCache(evalCache const&) = delete;
+	void operator=(evalCache const&) = delete;
+
+	static constexpr uint64_t _keyMask = 0xFFFFFFFF00000000ull;
+
+public:
+	static constexpr unsigned int defaultSize = 1;	// MB
+
+	static evalCache& getInstance()
+	{
+		static evalCache instance;
+		return instance;
+	}
+
+	/*! \brief resize the cache to the biggest power of 2 number of entries fitting in mbSize megabytes, 0 disables it
+	*/
+	void setSize(const unsigned int mbSize);
+	unsigned int getSize() const { return _mbSize; }
+	void clear();
+
+	bool probe(const HashKey& k, Score& eval) const
+	{
+		if( !_mbSize )
+		{
+			return false;
+		}
+		ttStatistics::count( ttStatistics::evalCacheProbes );
+		const uint64_t e = _table[ k.getKey() & _mask ].load( std::memory_order_relaxed );
+		if( ( e ^ k.getKey() ) & _keyMask )
+		{
+			return false;
+		}
+		ttStatistics::count( ttStatistics::evalCacheHits );
+		eval = Score( int32_t( uint32_t( e ) ) );
+		return true;
+	}
+
+	void store(const HashKey& k, const Score eval)
+	{
+		if( _mbSize )
+		{
+			_table[ k.getKey() & _mask ].store( ( k.getKey() & _keyMask ) | uint32_t( eval ), std::memory_order_relaxed );
+		}
+	}
+};
+
+/*! \brief hash table used by perft, independent from the search one
+	every cluster holds 3 entries with the full key, the depth and the 64 bit node count
+*/
 class PerftTranspositionTable
 {
+private:
+	struct alignas(64) perftCluster
+	{
+		uint64_t key[3];
+		uint64_t count[3];
+		uint8_t depth[3];	// 0 means empty
+		uint8_t padding[13];
+	};
+	static_assert( sizeof(perftCluster) == 64, "perftCluster shall fill a cache line" );
+
+	std::vector<perftCluster> _table;
+	unsigned long int _mbSize;
+
+	explicit PerftTranspositionTable(): _mbSize(16){}
+	PerftTranspositionTable(PerftTranspositionTable const&) = delete;
+	void operator=(PerftTranspositionTable const&) = delete;
+
+	perftCluster& findCluster(const HashKey& key)
+	{
+		return _table[ static_cast<size_t>( mulHigh64( key.getKey(), _table.size() ) ) ];
+	}
+
 public:
-	explicit PerftTranspositionTable(){}
+	static PerftTranspositionTable& getInstance()
+	{
+		static PerftTranspositionTable instance;
+		return instance;
+	}
+
+	/*! \brief set the size of the table, the memory is allocated at the first store
+	*/
+	void setSize(unsigned long int mbSize);
+	void clear();
 	
 	void store(const HashKey& key, signed short int depth, unsigned long long v);
 	bool retrieve(const HashKey& key, unsigned int depth, unsigned long long& res);
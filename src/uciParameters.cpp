@@ -26,5 +26,13 @@ unsigned int uciParameters::SyzygyProbeDepth = 1;
 bool uciParameters::Syzygy50MoveRule =  true;
 bool uciParameters::Ponder;
 bool uciParameters::Chess960 = false;
+bool uciParameters::largePages = true;
+unsigned int uciParameters::hashSize = 0;	// set by the Hash option, 0 until the table is allocated
+std::string uciParameters::sharedHash = "<empty>";
+bool uciParameters::qsearchHash = false;
+unsigned int uciParameters::pawnHashSize = 1;
+bool uciParameters::sharedPawnHash = false;
+bool uciParameters::useNnue = false;
+std::string uciParameters::evalFile = "<empty>";
 
 
@@ -32,6 +32,14 @@ public:
 	static bool Syzygy50MoveRule;
 	static bool Ponder;
 	static bool Chess960;
+	static bool largePages;
+	static unsigned int hashSize;
+	static std::string sharedHash;
+	static bool qsearchHash;
+	static unsigned int pawnHashSize;
+	static bool sharedPawnHash;
+	static bool useNnue;
+	static std::string evalFile;
 };
 
 #endif
@@ -28,6 +28,8 @@
 //#define DEBUG_EVAL_SIMMETRY
 //#define DISABLE_TIME_DIPENDENT_OUTPUT
 //#define ENABLE_CHECK_CONSISTENCY
+//#define ENABLE_TT_STATISTICS
+//#define COMPACT_MAGIC_ATTACKS
 
 
 
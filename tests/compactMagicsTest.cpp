@@ -0,0 +1,103 @@
+/*
+	This file is part of Vajolet.
+
+    Vajolet is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    Vajolet is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with Vajolet.  If not, see <http://www.gnu.org/licenses/>
+*/
+
+#include <random>
+
+#include "gtest/gtest.h"
+#include "compactMagics.h"
+#include "magicmoves.h"
+#include "movepicker.h"
+#include "position.h"
+
+static bitMap magicRookAttacks( const tSquare sq, const bitMap occupancy )
+{
+	return *( magicmoves_r_indices[sq] + ( ( ( occupancy & magicmoves_r_mask[sq] ) * magicmoves_r_magics[sq] ) >> magicmoves_r_shift[sq] ) );
+}
+
+static bitMap magicBishopAttacks( const tSquare sq, const bitMap occupancy )
+{
+	return *( magicmoves_b_indices[sq] + ( ( ( occupancy & magicmoves_b_mask[sq] ) * magicmoves_b_magics[sq] ) >> magicmoves_b_shift[sq] ) );
+}
+
+TEST(CompactMagics, allOccupancies)
+{
+	// builds without COMPACT_MAGIC_ATTACKS don't fill the tables at startup, the USE_PEXT one doesn't fill the magics
+	CompactMagics::init();
+	initmagicmoves();
+
+	std::mt19937_64 rng( 17 );
+	for( tSquare sq = A1; sq < squareNumber; ++sq )
+	{
+		// every relevant occupancy, with some noise outside the mask
+		bitMap occupancy = 0;
+		do
+		{
+			const bitMap noise = rng() & ~magicmoves_r_mask[sq];
+			EXPECT_EQ( CompactMagics::rookAttacks( sq, occupancy | noise ), magicRookAttacks( sq, occupancy | noise ) );
+			occupancy = ( occupancy - magicmoves_r_mask[sq] ) & magicmoves_r_mask[sq];
+		}
+		while( occupancy );
+
+		do
+		{
+			const bitMap noise = rng() & ~magicmoves_b_mask[sq];
+			EXPECT_EQ( CompactMagics::bishopAttacks( sq, occupancy | noise ), magicBishopAttacks( sq, occupancy | noise ) );
+			occupancy = ( occupancy - magicmoves_b_mask[sq] ) & magicmoves_b_mask[sq];
+		}
+		while( occupancy );
+	}
+}
+
+// perft that checks the slider attacks of every square with the occupancy of every node
+static unsigned long long sliderPerft( Position& pos, const unsigned int depth )
+{
+	const bitMap occupancy = pos.getOccupationBitmap();
+	for( tSquare sq = A1; sq < squareNumber; ++sq )
+	{
+		EXPECT_EQ( CompactMagics::rookAttacks( sq, occupancy ), magicRookAttacks( sq, occupancy ) );
+		EXPECT_EQ( CompactMagics::bishopAttacks( sq, occupancy ), magicBishopAttacks( sq, occupancy ) );
+	}
+	if( depth == 0 )
+	{
+		return 1;
+	}
+
+	unsigned long long tot = 0;
+	Move m;
+	MovePicker mp( pos );
+	while( ( m = mp.getNextMove() ) )
+	{
+		pos.doMove( m );
+		tot += sliderPerft( pos, depth - 1 );
+		pos.undoMove();
+	}
+	return tot;
+}
+
+TEST(CompactMagics, perftEquivalence)
+{
+	CompactMagics::init();
+	initmagicmoves();
+
+	Position pos;
+	pos.setupFromFen( "r3k2r/p1ppqpb1/bn2pnp1/3PN3/1p2P3/2N2Q1p/PPPBBPPP/R3K2R w KQkq - 0 1" );
+	EXPECT_EQ( sliderPerft( pos, 2 ), 2039ull );
+	pos.setupFromFen( "8/2p5/3p4/KP5r/1R3p1k/8/4P1P1/8 w - - 0 1" );
+	EXPECT_EQ( sliderPerft( pos, 3 ), 2812ull );
+	pos.setupFromFen( "r4rk1/1pp1qppp/p1np1n2/2b1p1B1/2B1P1b1/P1NP1N2/1PP1QPPP/R4RK1 w - - 0 10" );
+	EXPECT_EQ( sliderPerft( pos, 2 ), 2079ull );
+}
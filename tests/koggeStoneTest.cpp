@@ -0,0 +1,76 @@
+/*
+	This file is part of Vajolet.
+
+    Vajolet is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    Vajolet is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with Vajolet.  If not, see <http://www.gnu.org/licenses/>
+*/
+
+#include <random>
+
+#include "gtest/gtest.h"
+#include "data.h"
+#include "koggeStone.h"
+#include "movegen.h"
+
+static bitMap magicRookAttacks( bitMap rooks, const bitMap occupancy )
+{
+	bitMap res = 0;
+	while( rooks )
+	{
+		res |= Movegen::attackFrom<whiteRooks>( iterateBit( rooks ), occupancy );
+	}
+	return res;
+}
+
+static bitMap magicBishopAttacks( bitMap bishops, const bitMap occupancy )
+{
+	bitMap res = 0;
+	while( bishops )
+	{
+		res |= Movegen::attackFrom<whiteBishops>( iterateBit( bishops ), occupancy );
+	}
+	return res;
+}
+
+TEST(KoggeStone, singlePiece)
+{
+	std::mt19937_64 rng( 7 );
+	for( tSquare sq = A1; sq < squareNumber; ++sq )
+	{
+		for( unsigned int i = 0; i < 200; ++i )
+		{
+			// sparse and dense boards, the slider square can be occupied or not
+			const bitMap occupancy = i & 1 ? rng() & rng() : rng() & rng() & rng();
+			EXPECT_EQ( KoggeStone::rookAttacks( bitSet( sq ), occupancy ), Movegen::attackFrom<whiteRooks>( sq, occupancy ) );
+			EXPECT_EQ( KoggeStone::bishopAttacks( bitSet( sq ), occupancy ), Movegen::attackFrom<whiteBishops>( sq, occupancy ) );
+			EXPECT_EQ( KoggeStone::queenAttacks( bitSet( sq ), occupancy ), Movegen::attackFrom<whiteQueens>( sq, occupancy ) );
+		}
+		EXPECT_EQ( KoggeStone::rookAttacks( bitSet( sq ), 0 ), Movegen::getRookPseudoAttack( sq ) );
+		EXPECT_EQ( KoggeStone::bishopAttacks( bitSet( sq ), 0 ), Movegen::getBishopPseudoAttack( sq ) );
+	}
+}
+
+TEST(KoggeStone, pieceSets)
+{
+	std::mt19937_64 rng( 11 );
+	for( unsigned int i = 0; i < 100000; ++i )
+	{
+		const bitMap occupancy = rng() & rng();
+		// a few sliders, the ones not on occupied squares included
+		const bitMap sliders = rng() & rng() & rng() & rng();
+		EXPECT_EQ( KoggeStone::rookAttacks( sliders, occupancy ), magicRookAttacks( sliders, occupancy ) );
+		EXPECT_EQ( KoggeStone::bishopAttacks( sliders, occupancy ), magicBishopAttacks( sliders, occupancy ) );
+	}
+	EXPECT_EQ( KoggeStone::rookAttacks( 0, 0 ), 0u );
+	EXPECT_EQ( KoggeStone::bishopAttacks( 0, ~0ull ), 0u );
+}
@@ -0,0 +1,274 @@
+/*
+	This file is part of Vajolet.
+
+    Vajolet is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    Vajolet is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with Vajolet.  If not, see <http://www.gnu.org/licenses/>
+*/
+
+#include <algorithm>
+#include <cstdio>
+#include <fstream>
+#include <random>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "gtest/gtest.h"
+#include "nnue.h"
+#include "position.h"
+#include "uciParameters.h"
+
+static const std::string netFile = "nnueTest.nnue";
+
+static const std::vector<std::string> nnueFens = {
+	"rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1",
+	"r3k2r/p1ppqpb1/bn2pnp1/3PN3/1p2P3/2N2Q1p/PPPBBPPP/R3K2R w KQkq - 0 1",
+	"r3k2r/Pppp1ppp/1b3nbN/nP6/BBP1P3/q4N2/Pp1P2PP/R2Q1RK1 w kq - 0 1",
+	"rnbqkb1r/pp1p1ppp/5n2/2pPp3/8/8/PPP1PPPP/RNBQKBNR w KQkq c6 0 4",
+	"1k6/1b6/8/8/7R/8/8/4K2R b K - 0 1"
+};
+
+struct netData
+{
+	int32_t outputScale = 1 << nnue::outputShift;
+	std::vector<int16_t> ftBias = std::vector<int16_t>( nnue::halfDimensions, 0 );
+	std::vector<int16_t> ftWeights = std::vector<int16_t>( nnue::inputs * nnue::halfDimensions, 0 );
+	std::vector<int32_t> hiddenBias = std::vector<int32_t>( nnue::hiddenDimensions, 0 );
+	std::vector<int8_t> hiddenWeights = std::vector<int8_t>( nnue::hiddenDimensions * 2 * nnue::halfDimensions, 0 );
+	int32_t outputBias = 0;
+	std::vector<int8_t> outputWeights = std::vector<int8_t>( nnue::hiddenDimensions, 0 );
+};
+
+template<typename T> static void write( std::ofstream& f, const T* v, size_t n )
+{
+	f.write( reinterpret_cast<const char*>( v ), std::streamsize( n * sizeof(T) ) );
+}
+
+static void writeNet( const netData& d, const std::string& path, const uint32_t magic = nnue::magic, const size_t skipBytes = 0, const bool trailing = false )
+{
+	const uint32_t header[4] = { magic, nnue::inputs, nnue::halfDimensions, nnue::hiddenDimensions };
+	{
+		std::ofstream f( path, std::ios::binary );
+		write( f, header, 4 );
+		write( f, &d.outputScale, 1 );
+		write( f, d.ftBias.data(), d.ftBias.size() );
+		write( f, d.ftWeights.data(), d.ftWeights.size() );
+		write( f, d.hiddenBias.data(), d.hiddenBias.size() );
+		write( f, d.hiddenWeights.data(), d.hiddenWeights.size() - skipBytes );
+		if( !skipBytes )
+		{
+			write( f, &d.outputBias, 1 );
+			write( f, d.outputWeights.data(), d.outputWeights.size() );
+		}
+		if( trailing )
+		{
+			write( f, &d.outputBias, 1 );
+		}
+	}
+}
+
+static netData randomNet()
+{
+	std::mt19937 rng( 42 );
+	std::uniform_int_distribution<int> ft( -20, 40 ), w8( -60, 60 ), b( -500, 500 );
+	netData d;
+	for( auto& v: d.ftBias ) { v = int16_t( ft( rng ) ); }
+	for( auto& v: d.ftWeights ) { v = int16_t( ft( rng ) ); }
+	for( auto& v: d.hiddenBias ) { v = b( rng ); }
+	for( auto& v: d.hiddenWeights ) { v = int8_t( w8( rng ) ); }
+	d.outputBias = b( rng );
+	for( auto& v: d.outputWeights ) { v = int8_t( w8( rng ) ); }
+	return d;
+}
+
+// the same position with colors swapped and the board flipped
+static std::string mirrorFen( const std::string& fen )
+{
+	std::istringstream ss( fen );
+	std::string board, turn, castle, ep, rest;
+	ss >> board >> turn >> castle >> ep;
+	std::getline( ss, rest );
+
+	auto swapCase = []( std::string s ){ for( auto& c: s ) { c = char( isupper( c ) ? tolower( c ) : toupper( c ) ); } return s; };
+	std::vector<std::string> ranks;
+	std::istringstream b( board );
+	for( std::string r; std::getline( b, r, '/' ); ) { ranks.insert( ranks.begin(), swapCase( r ) ); }
+	std::string res;
+	for( auto& r: ranks ) { res += ( res.empty() ? "" : "/" ) + r; }
+	if( ep != "-" ) { ep[1] = char( '9' - ( ep[1] - '0' ) ); }
+	return res + " " + ( turn == "w" ? "b" : "w" ) + " " + ( castle == "-" ? castle : swapCase( castle ) ) + " " + ep + rest;
+}
+
+class nnueTest : public ::testing::Test
+{
+protected:
+	void TearDown() override
+	{
+		nnue::getInstance().unload();
+		uciParameters::useNnue = false;
+		std::remove( netFile.c_str() );
+	}
+};
+
+TEST_F(nnueTest, loader)
+{
+	nnue& net = nnue::getInstance();
+	const netData d = randomNet();
+
+	EXPECT_FALSE( net.load( "missingFile.nnue" ) );
+	EXPECT_FALSE( net.isLoaded() );
+
+	writeNet( d, netFile, 0x12345678 );
+	EXPECT_FALSE( net.load( netFile ) );
+
+	writeNet( d, netFile, nnue::magic, 100 );
+	EXPECT_FALSE( net.load( netFile ) );
+
+	writeNet( d, netFile, nnue::magic, 0, true );
+	EXPECT_FALSE( net.load( netFile ) );
+	EXPECT_FALSE( net.isLoaded() );
+
+	writeNet( d, netFile );
+	EXPECT_TRUE( net.load( netFile ) );
+	EXPECT_TRUE( net.isLoaded() );
+
+	// a bad file doesn't replace the loaded network
+	writeNet( d, netFile, 0x12345678 );
+	EXPECT_FALSE( net.load( netFile ) );
+	EXPECT_TRUE( net.isLoaded() );
+}
+
+TEST_F(nnueTest, constantNetwork)
+{
+	// every hidden neuron outputs 5, the output is 100 + 32 * 5 * 2
+	netData d;
+	for( auto& v: d.hiddenBias ) { v = 5 << nnue::hiddenShift; }
+	for( auto& v: d.outputWeights ) { v = 2; }
+	d.outputBias = 100;
+	writeNet( d, netFile );
+	ASSERT_TRUE( nnue::getInstance().load( netFile ) );
+	uciParameters::useNnue = true;
+
+	Position pos;
+	pos.updateNnue();
+	ASSERT_TRUE( pos.isNnueActive() );
+	for( auto& f: nnueFens )
+	{
+		pos.setupFromFen( f );
+		EXPECT_EQ( pos.eval<false>(), 420 );
+	}
+
+	uciParameters::useNnue = false;
+	pos.updateNnue();
+	EXPECT_FALSE( pos.isNnueActive() );
+}
+
+TEST_F(nnueTest, incrementalUpdate)
+{
+	writeNet( randomNet(), netFile );
+	ASSERT_TRUE( nnue::getInstance().load( netFile ) );
+	uciParameters::useNnue = true;
+
+	Position pos, fresh, mirror;
+	pos.updateNnue();
+	fresh.updateNnue();
+	mirror.updateNnue();
+	for( auto& f: nnueFens )
+	{
+		pos.setupFromFen( f );
+		pos.eval<false>();
+		for( unsigned int i = 0; i < 65535; ++i )
+		{
+			Move m( i );
+			if( pos.isMoveLegal( m ) )
+			{
+				pos.doMove( m );
+				// updated from the parent accumulator, calculated from scratch and seen from the other side
+				fresh.setupFromFen( pos.getFen() );
+				mirror.setupFromFen( mirrorFen( pos.getFen() ) );
+				const Score s = pos.eval<false>();
+				EXPECT_EQ( s, fresh.eval<false>() );
+				EXPECT_EQ( s, mirror.eval<false>() );
+
+				// two plies without evaluating the intermediate position
+				if( !pos.isInCheck() )
+				{
+					pos.doNullMove();
+					pos.doNullMove();
+					EXPECT_EQ( pos.eval<false>(), s );
+					pos.undoNullMove();
+					pos.undoNullMove();
+				}
+				pos.undoMove();
+			}
+		}
+	}
+}
+
+// plain implementation of the network, to check the simd kernels
+static Score referenceEval( const netData& d, const Position& pos )
+{
+	std::vector<int> acc[2];
+	for( const Color c: { white, black } )
+	{
+		acc[c].assign( d.ftBias.begin(), d.ftBias.end() );
+		for( bitboardIndex p = whiteKing; p <= blackPawns; p = bitboardIndex( p + 1 ) )
+		{
+			bitMap b = isValidPiece( p ) ? pos.getBitmap( p ) : 0;
+			while( b )
+			{
+				const unsigned int f = nnue::featureIndex( c, p, iterateBit( b ) );
+				for( unsigned int i = 0; i < nnue::halfDimensions; ++i )
+				{
+					acc[c][i] += d.ftWeights[ f * nnue::halfDimensions + i ];
+				}
+			}
+		}
+	}
+
+	const Color us = pos.isBlackTurn() ? black : white;
+	std::vector<int> input;
+	for( const Color c: { us, Color( 1 - us ) } )
+	{
+		for( auto v: acc[c] ) { input.push_back( std::min( std::max( v, 0 ), 127 ) ); }
+	}
+	int64_t out = d.outputBias;
+	for( unsigned int i = 0; i < nnue::hiddenDimensions; ++i )
+	{
+		int32_t h = d.hiddenBias[i];
+		for( unsigned int j = 0; j < 2 * nnue::halfDimensions; ++j )
+		{
+			h += input[j] * d.hiddenWeights[ i * 2 * nnue::halfDimensions + j ];
+		}
+		out += std::min( std::max( h >> nnue::hiddenShift, 0 ), 127 ) * d.outputWeights[i];
+	}
+	return Score( ( out * d.outputScale ) >> nnue::outputShift );
+}
+
+TEST_F(nnueTest, referenceEvaluation)
+{
+	const netData d = randomNet();
+	writeNet( d, netFile );
+	ASSERT_TRUE( nnue::getInstance().load( netFile ) );
+	uciParameters::useNnue = true;
+
+	Position pos;
+	pos.updateNnue();
+	for( auto& f: nnueFens )
+	{
+		pos.setupFromFen( f );
+		EXPECT_EQ( pos.eval<false>(), referenceEval( d, pos ) );
+		pos.setupFromFen( mirrorFen( f ) );
+		EXPECT_EQ( pos.eval<false>(), referenceEval( d, pos ) );
+	}
+}
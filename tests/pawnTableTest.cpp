@@ -0,0 +1,146 @@
+/*
+	This file is part of Vajolet.
+
+    Vajolet is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    Vajolet is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with Vajolet.  If not, see <http://www.gnu.org/licenses/>
+*/
+
+#include <atomic>
+#include <random>
+#include <thread>
+#include <vector>
+
+#include "gtest/gtest.h"
+#include "hashKey.h"
+#include "pawnTable.h"
+#include "uciParameters.h"
+
+// every field stored in the table is derived from the key, so any entry mixing two stores can be detected
+static void store(pawnTable& pt, const uint64_t k)
+{
+	bitMap attacks[lastBitboard] = {};
+	attacks[whitePawns] = k * 3;
+	attacks[blackPawns] = k * 5;
+	const bitMap b[2] = { k * 7, k * 11 };
+	pt.insert(HashKey(k), simdScore{ Score( k % 1000 ), -Score( k % 777 ), 0, 0 }, k, ~k, attacks, b, b);
+}
+
+static bool check(const pawnTable& pt, const uint64_t k, bool& found)
+{
+	simdScore res;
+	bitMap weakPawns, passedPawns;
+	bitMap attacks[lastBitboard], weakSquares[2], holes[2];
+	found = pt.getValues(HashKey(k), res, weakPawns, passedPawns, attacks, weakSquares, holes);
+	return !found || ( res[0] == Score( k % 1000 ) && res[1] == -Score( k % 777 )
+		&& weakPawns == k && passedPawns == ~k
+		&& attacks[whitePawns] == k * 3 && attacks[blackPawns] == k * 5
+		&& weakSquares[white] == k * 7 && weakSquares[black] == k * 11
+		&& holes[white] == k * 7 && holes[black] == k * 11 );
+}
+
+TEST(pawnTable, insertAndProbe) {
+	pawnTable pt(1);
+	EXPECT_EQ(pt.getEntries(), 8192u);
+
+	bool found;
+	EXPECT_TRUE(check(pt, 0x123456789ull, found));
+	EXPECT_FALSE(found);
+	// an empty entry doesn't match the key 0
+	EXPECT_TRUE(check(pt, 0, found));
+	EXPECT_FALSE(found);
+
+	store(pt, 0x123456789ull);
+	EXPECT_TRUE(check(pt, 0x123456789ull, found));
+	EXPECT_TRUE(found);
+
+	pt.clear();
+	EXPECT_TRUE(check(pt, 0x123456789ull, found));
+	EXPECT_FALSE(found);
+}
+
+TEST(pawnTable, size) {
+	pawnTable pt(4);
+	EXPECT_EQ(pt.getSize(), 4u);
+	EXPECT_EQ(pt.getEntries(), 32768u);
+	pt.setSize(1);
+	EXPECT_EQ(pt.getEntries(), 8192u);
+}
+
+TEST(pawnTable, sharedTable) {
+	const auto oldShared = uciParameters::sharedPawnHash;
+
+	uciParameters::sharedPawnHash = false;
+	EXPECT_NE(pawnTable::create(), pawnTable::create());
+	EXPECT_FALSE(pawnTable::create()->isShared());
+
+	uciParameters::sharedPawnHash = true;
+	const auto t = pawnTable::create();
+	EXPECT_EQ(t, pawnTable::create());
+	EXPECT_TRUE(t->isShared());
+
+	uciParameters::sharedPawnHash = oldShared;
+}
+
+TEST(pawnTable, concurrentAccessNeverReturnsCorruptedEntries) {
+	pawnTable pt(1);
+
+	std::atomic<unsigned long long> hits(0);
+	std::atomic<unsigned long long> errors(0);
+
+	// the key pool is bigger than the table, so that threads keep overwriting each other's entries
+	auto worker = [&](unsigned int seed) {
+		std::mt19937_64 rnd(seed);
+		for (unsigned int i = 0; i < 100000; ++i) {
+			const uint64_t k = ( rnd() % 65536 ) * 0x9E3779B97F4A7C15ull;
+			if (rnd() & 1) {
+				store(pt, k);
+			} else {
+				bool found;
+				if (!check(pt, k, found)) {
+					++errors;
+				}
+				hits += found;
+			}
+		}
+	};
+
+	std::vector<std::thread> threads;
+	for (unsigned int t = 0; t < 16; ++t) {
+		threads.emplace_back(worker, t);
+	}
+	for (auto& t : threads) {
+		t.join();
+	}
+
+	EXPECT_GT(hits.load(), 0u);
+	EXPECT_EQ(errors.load(), 0u);
+}
+
+TEST(pawnTable, shieldStorm) {
+	pawnTable pt(1);
+	HashKey k(0x0123456789ABCDEFull);
+	Score s = 0;
+
+	EXPECT_FALSE(pt.getShieldStorm(k, s));
+	pt.insertShieldStorm(k, -1234);
+	EXPECT_TRUE(pt.getShieldStorm(k, s));
+	EXPECT_EQ(s, -1234);
+
+	// the same pawns with the king on another square
+	HashKey k2 = k;
+	k2.updatePiece(G1, whiteKing);
+	EXPECT_FALSE(pt.getShieldStorm(k2, s));
+
+	pt.clear();
+	EXPECT_FALSE(pt.getShieldStorm(k, s));
+}
@@ -72,4 +72,28 @@ TEST(PerftTest, divide) {
 	}
 	
 	std::cout.rdbuf( oldCoutStreamBuf );
-}
\ No newline at end of file
+}
+
+TEST(PerftTest, perftHashIsIndependentFromSearchHash) {
+	Position pos;
+	PerftTranspositionTable::getInstance().setSize(1);
+	pos.setupFromFen(perftPos[1].Fen);
+
+	transpositionTable::getInstance().setSize(1);
+	transpositionTable::getInstance().clear();
+
+	Perft::perftUseHash = true;
+	EXPECT_EQ(Perft(pos).perft(4), perftPos[1].PerftValue[3]);
+	// a second run is served by the perft hash
+	EXPECT_EQ(Perft(pos).perft(4), perftPos[1].PerftValue[3]);
+	EXPECT_EQ(transpositionTable::getInstance().probe(pos.getKey()).getType(), typeVoid);
+
+	// counts wider than 46 bits are stored exactly
+	const HashKey k(0x1234567890ABCDEFull);
+	unsigned long long res = 0;
+	PerftTranspositionTable::getInstance().store(k, 12, 0x7FFFFFFFFFFFFFFFull);
+	EXPECT_TRUE(PerftTranspositionTable::getInstance().retrieve(k, 12, res));
+	EXPECT_EQ(res, 0x7FFFFFFFFFFFFFFFull);
+	EXPECT_FALSE(PerftTranspositionTable::getInstance().retrieve(k, 11, res));
+	EXPECT_FALSE(PerftTranspositionTable::getInstance().retrieve(HashKey(0x1234567890ABCDEEull), 12, res));
+}
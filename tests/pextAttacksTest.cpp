@@ -0,0 +1,44 @@
+/*
+	This file is part of Vajolet.
+
+    Vajolet is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    Vajolet is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with Vajolet.  If not, see <http://www.gnu.org/licenses/>
+*/
+
+#include <random>
+
+#include "gtest/gtest.h"
+#include "magicmoves.h"
+#include "pextAttacks.h"
+
+TEST(PextAttacks, sameAsMagics)
+{
+	// builds without USE_PEXT don't fill the pext table at startup, the USE_PEXT one doesn't fill the magics
+	PextAttacks::init();
+	initmagicmoves();
+
+	std::mt19937_64 rng( 13 );
+	for( tSquare sq = A1; sq < squareNumber; ++sq )
+	{
+		for( unsigned int i = 0; i < 500; ++i )
+		{
+			const bitMap occupancy = i & 1 ? rng() & rng() : rng() & rng() & rng();
+			EXPECT_EQ( PextAttacks::rookAttacks( sq, occupancy ), *( magicmoves_r_indices[sq] + ( ( ( occupancy & magicmoves_r_mask[sq] ) * magicmoves_r_magics[sq] ) >> magicmoves_r_shift[sq] ) ) );
+			EXPECT_EQ( PextAttacks::bishopAttacks( sq, occupancy ), *( magicmoves_b_indices[sq] + ( ( ( occupancy & magicmoves_b_mask[sq] ) * magicmoves_b_magics[sq] ) >> magicmoves_b_shift[sq] ) ) );
+		}
+		EXPECT_EQ( PextAttacks::rookAttacks( sq, 0 ), *magicmoves_r_indices[sq] );
+		// only the relevant occupancy matters
+		EXPECT_EQ( PextAttacks::rookAttacks( sq, ~0ull ), PextAttacks::rookAttacks( sq, magicmoves_r_mask[sq] ) );
+		EXPECT_EQ( PextAttacks::bishopAttacks( sq, ~0ull ), PextAttacks::bishopAttacks( sq, magicmoves_b_mask[sq] ) );
+	}
+}
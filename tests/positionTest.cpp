@@ -128,6 +128,66 @@ TEST(PositionTest, getState) {
 	
 }
 
+TEST(PositionTest, longGameStateStack) {
+	Position pos;
+	pos.setupFromFen("rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1"); 
+	// a game longer than the preallocated history, the knights go back and forth
+	const Move shuffle[4] = { Move(G1,F3), Move(G8,F6), Move(F3,G1), Move(F6,G8) };
+	for( unsigned int i = 0; i < 2500; ++i )
+	{
+		pos.doMove(shuffle[i % 4]);
+	}
+	EXPECT_EQ(pos.getStateSize(), 2501u);
+	EXPECT_EQ(pos.getState(2).getCurrentMove(), Move(G8,F6));
+	EXPECT_TRUE(pos.hasRepeated());
+	for( unsigned int i = 0; i < 2500; ++i )
+	{
+		pos.undoMove();
+	}
+	EXPECT_EQ(pos.getStateSize(), 1u);
+	EXPECT_EQ(pos.getFen(), "rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1");
+}
+
+TEST(PositionTest, cloneForSearch) {
+	Position pos, clone;
+	pos.setupFromFen("rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1"); 
+	pos.doMove(Move(E2,E4));
+	pos.doMove(Move(E7,E5));
+	const Move shuffle[4] = { Move(G1,F3), Move(B8,C6), Move(F3,G1), Move(C6,B8) };
+	for( unsigned int i = 0; i < 6; ++i )
+	{
+		pos.doMove(shuffle[i % 4]);
+	}
+
+	// only the states after the last pawn move are copied
+	clone.cloneForSearch(pos);
+	EXPECT_EQ(clone.getStateSize(), 7u);
+	EXPECT_EQ(clone.getFen(), pos.getFen());
+	EXPECT_EQ(clone.getKey(), pos.getKey());
+	EXPECT_EQ(clone.hasRepeated(), pos.hasRepeated());
+	EXPECT_TRUE(clone.hasRepeated());
+	EXPECT_FALSE(clone.hasRepeated(true));
+
+	// the same repetitions are found after the clone
+	for( unsigned int i = 6; i < 12; ++i )
+	{
+		pos.doMove(shuffle[i % 4]);
+		clone.doMove(shuffle[i % 4]);
+		EXPECT_EQ(clone.hasRepeated(), pos.hasRepeated());
+		EXPECT_EQ(clone.hasRepeated(true), pos.hasRepeated(true));
+	}
+	EXPECT_TRUE(clone.hasRepeated(true));
+
+	// whatever the length of the game at most 101 states are copied
+	for( unsigned int i = 0; i < 400; ++i )
+	{
+		pos.doMove(shuffle[i % 4]);
+	}
+	clone.cloneForSearch(pos);
+	EXPECT_EQ(clone.getStateSize(), 101u);
+	EXPECT_TRUE(clone.hasRepeated(true));
+}
+
 TEST(PositionTest, getGamePhaseOpening) {
 	Position pos;
 	pos.setupFromFen("rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1"); 
@@ -165,3 +225,117 @@ TEST(PositionTest, getFen) {
 
 	}
 }
+
+TEST(PositionTest, keyAfter) {
+	Position pos;
+	for (auto & p : perftPos)
+	{
+		pos.setupFromFen(p.Fen);
+		for( unsigned int i = 0; i< 65535; ++i)
+		{
+			Move m(i);
+			if( pos.isMoveLegal(m) && !m.isCastleMove() && !m.isPromotionMove() )
+			{
+				const HashKey k = pos.keyAfter(m);
+				const eCastle cr = pos.getActualState().getCastleRights();
+				pos.doMove(m);
+				// the estimate is exact unless castle rights change or an en passant square is set
+				if( !pos.getActualState().hasEpSquare() && pos.getActualState().getCastleRights() == cr && !m.isEnPassantMove() )
+				{
+					EXPECT_EQ(k, pos.getKey());
+				}
+				pos.undoMove();
+			}
+		}
+	}
+}
+
+TEST(PositionTest, materialTable) {
+	Position pos;
+	Position noTable(Position::pawnHash::off);
+	Position::materialEntry e;
+	for (auto & p : perftPos)
+	{
+		pos.setupFromFen(p.Fen);
+		for( unsigned int i = 0; i< 65535; ++i)
+		{
+			Move m(i);
+			if( pos.isMoveLegal(m) )
+			{
+				pos.doMove(m);
+				// the cached data is the same calculated from scratch, and so is the evaluation
+				pos.calcMaterialData(e);
+				const Position::materialEntry& t = pos.getMaterialData();
+				EXPECT_EQ(t.key, e.key);
+				EXPECT_EQ(t.gamePhase, e.gamePhase);
+				EXPECT_EQ(t.hasEndgame, e.hasEndgame);
+				EXPECT_EQ(t.loneKing, e.loneKing);
+				EXPECT_EQ(t.imbalance[0], e.imbalance[0]);
+				EXPECT_EQ(t.imbalance[1], e.imbalance[1]);
+				EXPECT_EQ(t.gamePhase, pos.getGamePhase(pos.getActualState()));
+
+				noTable.setupFromFen(pos.getFen());
+				EXPECT_EQ(pos.eval<false>(), noTable.eval<false>());
+				pos.undoMove();
+			}
+		}
+	}
+
+	// known endgames are found
+	pos.setupFromFen("kb6/8/8/8/8/8/8/6BK w - - 0 1");
+	EXPECT_TRUE(pos.getMaterialData().hasEndgame);
+	pos.setupFromFen("k7/8/8/8/8/8/8/5QRK w - - 0 1");
+	EXPECT_FALSE(pos.getMaterialData().hasEndgame);
+	EXPECT_TRUE(pos.getMaterialData().loneKing);
+}
+
+TEST(PositionTest, attackMaps) {
+	Position pos;
+	Position fresh;
+	for (auto & p : perftPos)
+	{
+		pos.setupFromFen(p.Fen);
+		for( unsigned int i = 0; i< 65535; ++i)
+		{
+			Move m(i);
+			if( pos.isMoveLegal(m) )
+			{
+				pos.doMove(m);
+				// the incrementally updated maps are the same calculated from scratch
+				fresh.setupFromFen(pos.getFen());
+				for( bitboardIndex b = whiteKing; b <= blackPieces; b = bitboardIndex( b + 1 ) )
+				{
+					if( b != separationBitmap )
+					{
+						EXPECT_EQ(pos.getActualState().getAttacks(b), fresh.getActualState().getAttacks(b));
+					}
+				}
+				pos.undoMove();
+			}
+		}
+	}
+}
+
+TEST(PositionTest, lazyEval) {
+	Position pos;
+	for (auto & p : perftPos)
+	{
+		pos.setupFromFen(p.Fen);
+		const Score full = pos.eval<false>();
+		bool exact;
+
+		// an open window always gets the full evaluation
+		EXPECT_EQ(pos.eval(-SCORE_INFINITE, SCORE_INFINITE, exact), full);
+		EXPECT_TRUE(exact);
+
+		// a window far from the score gets an estimate on the right side of it
+		EXPECT_GE(pos.eval(full - 400000, full - 300000, exact), full - 300000);
+		EXPECT_FALSE(exact);
+		EXPECT_LE(pos.eval(full + 300000, full + 400000, exact), full + 300000);
+		EXPECT_FALSE(exact);
+
+		// a window around the score gets the full evaluation
+		EXPECT_EQ(pos.eval(full - 1, full + 1, exact), full);
+		EXPECT_TRUE(exact);
+	}
+}
@@ -71,6 +71,9 @@ TEST(search, search) {
 
 	for (auto & p : _p)
 	{
+		// every position is searched from empty tables, the results must not depend on the previous searches
+		transpositionTable::getInstance().clear();
+		evalCache::getInstance().clear();
 		src.getPosition().setupFromFen(p.Fen);
 		sl.setDepth(p.depth);
 		auto res = src.manageNewSearch();
@@ -0,0 +1,396 @@
+/*
+	This file is part of Vajolet.
+
+    Vajolet is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    Vajolet is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with Vajolet.  If not, see <http://www.gnu.org/licenses/>
+*/
+
+#include <atomic>
+#include <cstdio>
+#include <random>
+#include <thread>
+#include <vector>
+
+#if defined(__linux__)
+#include <sys/mman.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#endif
+
+#include "gtest/gtest.h"
+#include "hashKey.h"
+#include "move.h"
+#include "transposition.h"
+#include "uciParameters.h"
+
+// every field stored in the table is derived from the key, so any entry mixing two stores can be detected
+// values are within the exactly stored range and depths of half ply, so that they are stored exactly
+static Score valueOf(const uint64_t k){ return ( Score( k % 3001 ) - 1500 ) * 16; }
+static Score staticValueOf(const uint64_t k){ return ( Score( ( k >> 20 ) % 3001 ) - 1500 ) * 16; }
+static signed short int depthOf(const uint64_t k){ return (signed short int)( ( ( k >> 40 ) % 200 ) * 8 ); }
+static unsigned short moveOf(const uint64_t k){ return (unsigned short)( ( ( k >> 48 ) & 0x7FFF ) | 1 ); }
+
+TEST(transpositionTable, storeAndProbe) {
+	transpositionTable& tt = transpositionTable::getInstance();
+	tt.setSize(1);
+	tt.clear();
+
+	const HashKey k(0x123456789ABCDEF0ull);
+	tt.store(k, 12352, typeScoreHigherThanBeta, 160, Move(moveOf(k.getKey())), -2368);
+
+	const ttEntry tte = tt.probe(k);
+	EXPECT_EQ(tte.getValue(), 12352);
+	EXPECT_EQ(tte.getStaticValue(), -2368);
+	EXPECT_EQ(tte.getType(), typeScoreHigherThanBeta);
+	EXPECT_EQ(tte.getDepth(), 160);
+	EXPECT_EQ(tte.getPackedMove(), moveOf(k.getKey()));
+
+	EXPECT_EQ(tt.probe(HashKey(0x0FEDCBA987654321ull)).getType(), typeVoid);
+}
+
+TEST(transpositionTable, concurrentAccessNeverReturnsCorruptedEntries) {
+	transpositionTable& tt = transpositionTable::getInstance();
+	tt.setSize(1);
+	tt.clear();
+
+	// a key pool larger than the table, so that threads keep overwriting each other's entries.
+	// the keys differ in the 16 bits stored in the entries, so a wrong entry can only come from a torn write
+	std::vector<uint64_t> keys(1 << 16);
+	std::mt19937_64 gen(42);
+	for (unsigned int i = 0; i < keys.size(); ++i) {
+		keys[i] = ( gen() & ~0xFFFFull ) | i;
+	}
+
+	std::atomic<unsigned long long> hits(0);
+	std::atomic<unsigned long long> errors(0);
+
+	auto worker = [&](unsigned int seed) {
+		std::mt19937 rnd(seed);
+		for (unsigned int i = 0; i < 100000; ++i) {
+			const uint64_t k = keys[rnd() % keys.size()];
+			const HashKey hk(k);
+			if (rnd() & 1) {
+				tt.store(hk, valueOf(k), typeExact, depthOf(k), Move(moveOf(k)), staticValueOf(k));
+			} else {
+				const ttEntry tte = tt.probe(hk);
+				if (tte.getType() != typeVoid) {
+					++hits;
+					if (tte.getValue() != valueOf(k)
+						|| tte.getStaticValue() != staticValueOf(k)
+						|| tte.getDepth() != depthOf(k)
+						|| tte.getPackedMove() != moveOf(k)
+						|| tte.getType() != typeExact) {
+						++errors;
+					}
+				}
+			}
+		}
+	};
+
+	std::vector<std::thread> threads;
+	for (unsigned int t = 0; t < 32; ++t) {
+		threads.emplace_back(worker, t);
+	}
+	for (auto& t : threads) {
+		t.join();
+	}
+
+	EXPECT_GT(hits.load(), 0u);
+	EXPECT_EQ(errors.load(), 0u);
+}
+
+TEST(transpositionTable, allocationBacking) {
+	transpositionTable& tt = transpositionTable::getInstance();
+
+	// without large pages the table always falls back to normal pages
+	tt.setSize(4, false);
+	EXPECT_EQ(tt.getMemoryType(), transpositionTable::memoryType::standard);
+
+	// with large pages any backing is acceptable, but the table has to be usable and empty
+	tt.setSize(4, true);
+	const HashKey k(0x0123456789ABCDEFull);
+	EXPECT_EQ(tt.probe(k).getType(), typeVoid);
+	tt.store(k, 128, typeExact, 32, Move(moveOf(k.getKey())), 64);
+	EXPECT_EQ(tt.probe(k).getValue(), 128);
+
+	tt.setSize(1);
+}
+
+TEST(transpositionTable, collisionRate) {
+	transpositionTable& tt = transpositionTable::getInstance();
+	// a size that is not a power of two, the index shall anyway spread over the whole table
+	const unsigned long int slots = tt.setSize(3);
+	tt.clear();
+
+	// fill a quarter of the table
+	std::mt19937_64 gen(7);
+	std::vector<uint64_t> keys(slots / 4);
+	for (auto& k : keys) {
+		k = gen();
+		tt.store(HashKey(k), valueOf(k), typeExact, 0, Move::NOMOVE, 0);
+	}
+
+	// only clusters receiving more than 3 keys shall lose entries, about 1.1% of them
+	unsigned int found = 0;
+	for (auto k : keys) {
+		const ttEntry tte = tt.probe(HashKey(k));
+		if (tte.getType() != typeVoid && tte.getValue() == valueOf(k)) {
+			++found;
+		}
+	}
+	EXPECT_GT(found, keys.size() * 98 / 100);
+
+	// keys never stored shall not be found
+	unsigned int falseHits = 0;
+	for (unsigned int i = 0; i < 1000000; ++i) {
+		falseHits += tt.probe(HashKey(gen())).getType() != typeVoid;
+	}
+	// about 3 entries every 4 clusters can match the 16 bit key of a random position, ~11 hits expected
+	EXPECT_LT(falseHits, 50u);
+
+	tt.setSize(1);
+}
+
+TEST(transpositionTable, multiThreadedClear) {
+	transpositionTable& tt = transpositionTable::getInstance();
+	const unsigned int oldThreads = uciParameters::threads;
+	uciParameters::threads = 7;
+	tt.setSize(3);
+
+	std::mt19937_64 gen(3);
+	std::vector<uint64_t> keys(10000);
+	for (auto& k : keys) {
+		k = gen();
+		tt.store(HashKey(k), 10, typeExact, 0, Move::NOMOVE, 0);
+	}
+	tt.clear();
+	for (auto k : keys) {
+		EXPECT_EQ(tt.probe(HashKey(k)).getType(), typeVoid);
+	}
+
+	uciParameters::threads = oldThreads;
+	tt.setSize(1);
+}
+
+static unsigned int countFound(transpositionTable& tt, const std::vector<uint64_t>& keys) {
+	unsigned int found = 0;
+	for (auto k : keys) {
+		const ttEntry tte = tt.probe(HashKey(k));
+		if (tte.getType() == typeExact && tte.getValue() == valueOf(k) && tte.getDepth() == depthOf(k)
+			&& tte.getStaticValue() == staticValueOf(k) && tte.getPackedMove() == moveOf(k)) {
+			++found;
+		}
+	}
+	return found;
+}
+
+TEST(transpositionTable, saveAndLoad) {
+	transpositionTable& tt = transpositionTable::getInstance();
+	const std::string fileName = "vajolet_tt_test.bin";
+	tt.setSize(2);
+
+	std::mt19937_64 gen(11);
+	std::vector<uint64_t> keys(5000);
+	for (auto& k : keys) {
+		k = gen();
+		tt.store(HashKey(k), valueOf(k), typeExact, depthOf(k), Move(moveOf(k)), staticValueOf(k));
+	}
+	ASSERT_TRUE(tt.saveToFile(fileName));
+
+	// same size, the table is restored as it was
+	tt.clear();
+	EXPECT_EQ(countFound(tt, keys), 0u);
+	ASSERT_TRUE(tt.loadFromFile(fileName));
+	EXPECT_EQ(countFound(tt, keys), keys.size());
+
+	// a smaller table, the entries are rehashed
+	tt.setSize(1);
+	ASSERT_TRUE(tt.loadFromFile(fileName));
+	EXPECT_GT(countFound(tt, keys), keys.size() * 99 / 100);
+
+	// a bigger table, only part of the entries can be placed where they are searched
+	tt.setSize(4);
+	ASSERT_TRUE(tt.loadFromFile(fileName));
+	EXPECT_GT(countFound(tt, keys), keys.size() / 4);
+
+	EXPECT_FALSE(tt.loadFromFile("not_existing_file.bin"));
+	std::remove(fileName.c_str());
+	tt.setSize(1);
+}
+
+#if defined(__linux__)
+TEST(transpositionTable, sharedHash) {
+	transpositionTable& tt = transpositionTable::getInstance();
+	const std::string name = "/vajolet_tt_test_" + std::to_string(getpid());
+	tt.setSize(1);
+	tt.setSharedName(name);
+	ASSERT_EQ(tt.getMemoryType(), transpositionTable::memoryType::sharedMemory);
+
+	std::mt19937_64 gen(5);
+	std::vector<uint64_t> keys(2000);
+	for (auto& k : keys) {
+		k = gen();
+	}
+
+	// another process attaches to the segment by name, asking for a different size, and fills it
+	const pid_t child = fork();
+	ASSERT_GE(child, 0);
+	if (child == 0) {
+		tt.setSize(4);
+		bool ok = tt.getMemoryType() == transpositionTable::memoryType::sharedMemory;
+		tt.newSearch();
+		for (auto k : keys) {
+			tt.store(HashKey(k), valueOf(k), typeExact, depthOf(k), Move(moveOf(k)), staticValueOf(k));
+		}
+		_exit(ok ? 0 : 1);
+	}
+	int status;
+	waitpid(child, &status, 0);
+	EXPECT_TRUE(WIFEXITED(status));
+	EXPECT_EQ(WEXITSTATUS(status), 0);
+
+	EXPECT_EQ(countFound(tt, keys), keys.size());
+	// the generation advanced by the other process is adopted at the next search
+	tt.newSearch();
+	EXPECT_EQ(tt.probe(HashKey(keys[0])).getGeneration(), 1);
+	EXPECT_EQ(tt.getFullness(), 0u);
+
+	tt.setSharedName("");
+	EXPECT_NE(tt.getMemoryType(), transpositionTable::memoryType::sharedMemory);
+	shm_unlink(name.c_str());
+	tt.setSize(1);
+}
+#endif
+
+TEST(transpositionTable, statistics) {
+	transpositionTable& tt = transpositionTable::getInstance();
+	tt.setSize(1);
+	ttStatistics::reset();
+
+	const HashKey k1(0x1111111111111111ull);
+	const HashKey k2(0x2222222222222222ull);
+	tt.store(k1, 10, typeExact, 16, Move::NOMOVE, 0);
+	tt.store(k1, 20, typeExact, 32, Move::NOMOVE, 0);
+	tt.probe(k1);
+	tt.probe(k2);
+	tt.refresh(k1);
+
+	// counters are collected by the threads too
+	std::thread t([&](){ tt.probe(k1); });
+	t.join();
+
+	const auto s = ttStatistics::get();
+	if (ttStatistics::enabled) {
+		EXPECT_EQ(s[ttStatistics::probes], 3u);
+		EXPECT_EQ(s[ttStatistics::hits], 2u);
+		EXPECT_EQ(s[ttStatistics::stores], 2u);
+		EXPECT_EQ(s[ttStatistics::sameKeyStores], 1u);
+		EXPECT_EQ(s[ttStatistics::overwrites], 0u);
+		EXPECT_EQ(s[ttStatistics::refreshes], 1u);
+	} else {
+		for (auto c : s) {
+			EXPECT_EQ(c, 0u);
+		}
+	}
+	EXPECT_NE(ttStatistics::format(s).find("tt probes"), std::string::npos);
+}
+
+TEST(transpositionTable, compactEntryEncoding) {
+	transpositionTable& tt = transpositionTable::getInstance();
+	tt.setSize(1);
+	const HashKey k(0x0A0B0C0D0E0F1011ull);
+
+	// small scores are exact
+	tt.store(k, 1001, typeScoreHigherThanBeta, 16, Move::NOMOVE, -1001);
+	EXPECT_EQ(tt.probe(k).getValue(), 1001);
+	EXPECT_EQ(tt.probe(k).getStaticValue(), -1001);
+
+	// big scores are rounded, but bounds remain valid bounds
+	tt.store(k, 100001, typeScoreHigherThanBeta, 16, Move::NOMOVE, 1000);
+	EXPECT_LE(tt.probe(k).getValue(), 100001);
+	EXPECT_GT(tt.probe(k).getValue(), 100001 - 256);
+	tt.store(k, 100001, typeScoreLowerThanAlpha, 16, Move::NOMOVE, 1000);
+	EXPECT_GE(tt.probe(k).getValue(), 100001);
+	EXPECT_LT(tt.probe(k).getValue(), 100001 + 256);
+	tt.store(k, -100001, typeScoreLowerThanAlpha, 16, Move::NOMOVE, 1000);
+	EXPECT_GE(tt.probe(k).getValue(), -100001);
+	EXPECT_LT(tt.probe(k).getValue(), -100001 + 256);
+	tt.store(k, -100001, typeScoreHigherThanBeta, 16, Move::NOMOVE, 1000);
+	EXPECT_LE(tt.probe(k).getValue(), -100001);
+	EXPECT_GT(tt.probe(k).getValue(), -100001 - 256);
+
+	// mate scores and none are exact
+	tt.store(k, SCORE_MATE - 17, typeExact, 16, Move::NOMOVE, SCORE_NONE);
+	EXPECT_EQ(tt.probe(k).getValue(), SCORE_MATE - 17);
+	EXPECT_EQ(tt.probe(k).getStaticValue(), SCORE_NONE);
+	tt.store(k, SCORE_MATED + 40, typeExact, 16, Move::NOMOVE, 0);
+	EXPECT_EQ(tt.probe(k).getValue(), SCORE_MATED + 40);
+
+	// depth is rounded down to half ply
+	tt.store(k, 0, typeExact, 16 * 10 + 5, Move::NOMOVE, 0);
+	EXPECT_EQ(tt.probe(k).getDepth(), 16 * 10);
+	tt.store(k, 0, typeExact, -16, Move::NOMOVE, 0);
+	EXPECT_EQ(tt.probe(k).getDepth(), -16);
+}
+
+TEST(transpositionTable, qsearchTable) {
+	qsearchTable qtt( 1024 );
+	const HashKey k(0x1122334455667788ull);
+
+	EXPECT_EQ(qtt.probe(k).getType(), typeVoid);
+
+	qtt.store(k, -2368, typeScoreHigherThanBeta, -16, moveOf(k.getKey()), 160);
+	ttEntry tte = qtt.probe(k);
+	EXPECT_EQ(tte.getValue(), -2368);
+	EXPECT_EQ(tte.getStaticValue(), 160);
+	EXPECT_EQ(tte.getType(), typeScoreHigherThanBeta);
+	EXPECT_EQ(tte.getDepth(), -16);
+	EXPECT_EQ(tte.getPackedMove(), moveOf(k.getKey()));
+
+	// a store without move keeps the move of the same position
+	qtt.store(k, 64, typeExact, -32, 0, 160);
+	tte = qtt.probe(k);
+	EXPECT_EQ(tte.getValue(), 64);
+	EXPECT_EQ(tte.getPackedMove(), moveOf(k.getKey()));
+
+	// the full key is verified, a position mapped on the same slot is not a hit
+	EXPECT_EQ(qtt.probe(HashKey(k.getKey() ^ ( 1ull << 40 ))).getType(), typeVoid);
+
+	qtt.clear();
+	EXPECT_EQ(qtt.probe(k).getType(), typeVoid);
+}
+
+TEST(transpositionTable, evalCache) {
+	evalCache& ec = evalCache::getInstance();
+	ec.setSize(1);
+	const HashKey k(0x0123456789ABCDEFull);
+	Score e = 0;
+
+	EXPECT_FALSE(ec.probe(k, e));
+	ec.store(k, -12345);
+	EXPECT_TRUE(ec.probe(k, e));
+	EXPECT_EQ(e, -12345);
+
+	// a key mapped on the same entry, differing in the verified bits
+	EXPECT_FALSE(ec.probe(HashKey(k.getKey() ^ ( 1ull << 63 )), e));
+
+	ec.clear();
+	EXPECT_FALSE(ec.probe(k, e));
+
+	// size 0 disables the cache
+	ec.setSize(0);
+	ec.store(k, 100);
+	EXPECT_FALSE(ec.probe(k, e));
+
+	ec.setSize(evalCache::defaultSize);
+}